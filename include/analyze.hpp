@@ -0,0 +1,30 @@
+#pragma once
+
+#include "mcts.hpp"
+
+struct AnalyzeOptions {
+	int workers = 1;
+	int simulations = 800; // per position, <= 0 for no limit (then movetime_ms must be set)
+	int64_t movetime_ms = 0; // per position, <= 0 for none
+	size_t hash_mb = 16; // node table per worker
+	uint64_t seed = 0;
+	PlayoutOptions playout;
+	const LeafEvaluator *evaluator = nullptr; // null: playouts with the options above
+	int batch = 1; // leaves per evaluator batch, see MCTS::set_batch_size
+	const Egtb *egtb = nullptr; // endgame tables for leaves and playouts
+};
+
+struct AnalyzeStats {
+	uint64_t positions = 0, errors = 0;
+	double seconds = 0;
+};
+
+// Searches every EPD/FEN line of in on opt.workers threads, each with its own MCTS, and writes
+// one line per position to out, in input order:
+//   <line number> <best move> <visits> <value> <fen>
+// value is the best move's mean result for the side to move. Unparsable lines yield
+// "<line number> error <text>"; blank lines and lines starting with '#' are skipped. At most a
+// few positions per worker are held at once, so input of any size streams in bounded memory.
+// Each position seeds the RNG from opt.seed and its line number, so a simulation-limited run
+// repeats for any worker count.
+AnalyzeStats run_analyze(std::istream &in, std::ostream &out, const AnalyzeOptions &opt);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "mcts.hpp"
+
+// Simulations/sec of one search at 1/2/4/8/16 threads on fresh trees, with speedup vs 1 thread.
+void bench_thread_scaling(int simulations, std::ostream &out);
+// Simulations/sec of one search with evaluator batches of 1/2/4/.../32 leaves on fresh trees,
+// with speedup vs unbatched (ev null: playouts).
+void bench_batch_sizes(int simulations, const LeafEvaluator *ev, int threads, std::ostream &out);
+
+struct BenchResult {
+	double movegen_per_s = 0; // generate_legal_moves calls
+	double perft_nps = 0; // leaf nodes of a make/unmake perft
+	double playouts_per_s = 0;
+	double sims_per_s = 0; // single-threaded search_best_move
+	double peak_rss_mb = 0;
+	double seconds = 0;
+};
+
+// Fixed, seeded suite: the same positions and random streams every run, single-threaded, no
+// Q-table, progress lines only between phases.
+BenchResult run_bench(std::ostream &log);
+std::string bench_to_json(const BenchResult &r);
+bool bench_from_json(const std::string &path, BenchResult &out); // reads what bench_to_json wrote
+// Prints each rate against base; false if any fell more than threshold_pct below it.
+bool bench_compare(const BenchResult &cur, const BenchResult &base, double threshold_pct, std::ostream &out);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "common.hpp"
+
+#if defined(__BMI2__) && !defined(NO_PEXT)
+#include <immintrin.h>
+#define USE_PEXT 1
+#endif
+
+// Square sets: bit n is square n (a1=0, h8=63).
+
+inline uint64_t square_bb(int sq) { return 1ull << sq; }
+inline int popcount(uint64_t b) { return __builtin_popcountll(b); }
+inline int lsb(uint64_t b) { return __builtin_ctzll(b); }
+inline int pop_lsb(uint64_t &b) { int sq = __builtin_ctzll(b); b &= b - 1; return sq; }
+inline bool more_than_one(uint64_t b) { return (b & (b - 1)) != 0; }
+
+constexpr uint64_t RANK_1_BB = 0xFFull;
+constexpr uint64_t RANK_8_BB = RANK_1_BB << 56;
+constexpr uint64_t FILE_A_BB = 0x0101010101010101ull;
+constexpr uint64_t FILE_H_BB = FILE_A_BB << 7;
+
+struct Magic {
+	uint64_t mask;
+	uint64_t magic;
+	uint64_t *attacks;
+	int shift;
+
+	inline unsigned index(uint64_t occ) const {
+#ifdef USE_PEXT
+		return (unsigned)_pext_u64(occ, mask);
+#else
+		return (unsigned)(((occ & mask) * magic) >> shift);
+#endif
+	}
+};
+
+extern uint64_t PAWN_ATTACKS[2][64]; // [0]=white, [1]=black
+extern uint64_t KNIGHT_ATTACKS[64];
+extern uint64_t KING_ATTACKS[64];
+extern Magic ROOK_MAGICS[64];
+extern Magic BISHOP_MAGICS[64];
+extern uint64_t BETWEEN_BB[64][64]; // squares strictly between two aligned squares, else 0
+extern uint64_t LINE_BB[64][64]; // full rank/file/diagonal through two aligned squares, else 0
+
+inline uint64_t rook_attacks(int sq, uint64_t occ) { const Magic &m = ROOK_MAGICS[sq]; return m.attacks[m.index(occ)]; }
+inline uint64_t bishop_attacks(int sq, uint64_t occ) { const Magic &m = BISHOP_MAGICS[sq]; return m.attacks[m.index(occ)]; }
+inline uint64_t queen_attacks(int sq, uint64_t occ) { return rook_attacks(sq, occ) | bishop_attacks(sq, occ); }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.hpp"
+#include "bitboard.hpp"
 
 struct Zobrist {
 	std::array<std::array<uint64_t, 64>, 13> piece_square; // index 0 unused
@@ -13,28 +14,78 @@ struct Zobrist {
 
 extern Zobrist ZOBRIST;
 
+// Everything unmake_move cannot cheaply recompute, pushed by make_move and popped on undo.
+struct StateInfo {
+	uint64_t hash; // position key before the move (also the repetition history)
+	Move move;
+	Piece captured;
+	uint8_t castling_rights;
+	int8_t ep_square;
+	uint16_t halfmove_clock;
+	int16_t material;
+	std::array<int8_t, 2> king_sq;
+};
+
+class Nnue;
+constexpr int NNUE_HIDDEN = 128; // first-layer width per perspective
+
+// First-layer sums of an Nnue for both perspectives (0 = white's view, 1 = black's).
+struct alignas(32) NnueAccumulator {
+	int16_t v[2][NNUE_HIDDEN];
+};
+
 struct Board {
 	std::array<Piece, 64> squares;
+	std::array<uint64_t, 13> pieces; // bitboard per piece code, indexed by piece+6
+	std::array<uint64_t, 2> colors; // 0=white,1=black
+	uint64_t occupied;
+	std::array<int8_t, 2> king_sq; // 0=white,1=black; -1 if absent
 	bool white_to_move;
 	uint8_t castling_rights; // bits: 1=WK,2=WQ,4=BK,8=BQ
 	int8_t ep_square; // -1 if none else 0..63
 	uint16_t halfmove_clock;
 	uint16_t fullmove_number;
 	uint64_t hash;
+	int16_t material; // incremental material balance, white minus black
+	std::vector<StateInfo> states; // one entry per move made on this board
+	const Nnue *nnue; // attached evaluator, null if none
+	std::vector<NnueAccumulator> nnue_acc; // one per ply since attach_nnue, updated by make/unmake
 
 	Board();
 	static Board startpos();
+	bool set_fen(const std::string &fen); // false (board untouched) on malformed input
+	std::string fen() const; // all six fields
+
+	inline uint64_t bb(Piece p) const { return pieces[p + 6]; }
+	inline uint64_t type_bb(int t) const { return pieces[6 + t] | pieces[6 - t]; }
+	void put_piece(int sq, Piece p);
+	void remove_piece(int sq);
+	void move_piece(int from, int to);
 
+	uint64_t attackers_to(int sq, uint64_t occ) const; // both colors
 	bool is_square_attacked(int sq, bool by_white) const;
 	bool in_check(bool for_white) const;
+	// Static exchange evaluation: centipawns the mover nets on m.to if both sides keep
+	// recapturing with their least valuable attacker (x-rays included, pins ignored).
+	int see(const Move &m) const;
 	void update_hash();
 
+	void generate_legal_moves(MoveList &out) const; // clears and fills out, no allocation
 	std::vector<Move> generate_legal_moves() const;
-	void make_move(const Move &m, Piece &captured_out, uint8_t &old_castle, int8_t &old_ep, uint16_t &old_half);
-	void unmake_move(const Move &m, Piece captured, uint8_t old_castle, int8_t old_ep, uint16_t old_half);
+	void make_move(const Move &m);
+	void unmake_move(); // undoes the last make_move in O(1)
+	inline size_t ply() const { return states.size(); }
+	inline void unmake_to(size_t p) { while (states.size() > p) unmake_move(); }
 
-	GameResult evaluate_terminal() const; // simple: checkmate/stalemate/50-move
-	int material_eval() const; // for playout bias
+	// true if this position occurred at least `times` times before, within the 50-move window
+	bool is_repetition(int times) const;
+	bool insufficient_material() const; // no mate possible for either side (KvK, minor vs K, same-colour bishops)
+	GameResult evaluate_terminal() const; // checkmate, stalemate, 50-move, threefold, insufficient material
+	inline int material_eval() const { return material; } // for playout bias
+	// Attaches net (null detaches) and computes the accumulator for the current position.
+	// From then on make_move/unmake_move keep it current in a few vector adds per move.
+	void attach_nnue(const Nnue *net);
+	void nnue_push(const Move &m); // called by make_move before the move is applied
 };
 
 inline int file_of(int sq) { return sq & 7; }
@@ -42,3 +93,4 @@ inline int rank_of(int sq) { return sq >> 3; }
 inline bool on_board(int sq) { return sq >= 0 && sq < 64; }
 inline int idx(int r, int f) { return (r << 3) | f; }
 
+std::string move_to_uci(const Move &m); // e.g. "e2e4", "e7e8q"
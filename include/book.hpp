@@ -0,0 +1,83 @@
+#pragma once
+
+#include "qstore.hpp"
+#include "trainfile.hpp"
+
+// Opening book: the moves that searches chose most often in the positions near the start.
+//
+// On disk (native byte order): a BookFileHeader, then `count` BookEntries sorted by hash and,
+// within a position, by falling weight. A weight is the number of visits the move received,
+// summed over the sources the book was built from. The file is mapped read-only and a probe is
+// a binary search.
+
+struct BookEntry {
+	uint64_t hash; // position before the move
+	uint32_t move; // pack_move code
+	uint32_t weight;
+};
+static_assert(sizeof(BookEntry) == 16, "on-disk entry layout");
+
+struct BookFileHeader {
+	char magic[8]; // "CRLBOOK\0"
+	uint32_t version;
+	uint32_t entry_size;
+	uint64_t count;
+};
+static_assert(sizeof(BookFileHeader) == 24, "on-disk header layout");
+
+constexpr uint32_t BOOK_VERSION = 1;
+
+// When a book move is played instead of searching.
+struct BookOptions {
+	uint32_t min_visits = 1000; // total weight of the position's book moves
+	float min_share = 0.4f; // share of that total on the most weighted move
+};
+
+class Book {
+public:
+	Book() = default;
+	~Book() { close(); }
+	Book(const Book&) = delete;
+	Book &operator=(const Book&) = delete;
+
+	bool open(const std::string &path); // false if missing or not a book of BOOK_VERSION
+	void close();
+	uint64_t size() const { return count; }
+
+	// Legal book moves of b with their weights, most weighted first; empty if b is not in the book.
+	void moves(const Board &b, std::vector<std::pair<Move,uint32_t>> &out) const;
+	// The most weighted book move of b, if the position clears opt.
+	bool pick(const Board &b, const BookOptions &opt, Move &out) const;
+
+private:
+	void *map = nullptr;
+	size_t map_len = 0;
+	const BookEntry *entries = nullptr;
+	uint64_t count = 0;
+};
+
+struct BookBuildOptions {
+	int max_plies = 20; // deepest position taken, counted from the start position
+	uint32_t min_visits = 200; // positions whose moves have less weight in total are left out
+	int max_moves = 8; // kept per position, most weighted first
+};
+
+// Collects move weights and writes a book. A move's weight from a Q file is the visit count of
+// the position it leads to; from training records it is the move's root visits, summed over
+// every record of the position. The book holds the positions reached from the start position
+// through book moves.
+class BookBuilder {
+public:
+	explicit BookBuilder(const BookBuildOptions &o = BookBuildOptions()) : opt(o) {}
+	void add_qfile(const QFile &q) { qfiles.push_back(&q); } // q must stay open until write
+	uint64_t add_records(TrainReader &r); // returns the number of records read; r.corrupt() tells why it stopped
+	// Writes the book via a temporary file and rename. False on I/O failure.
+	bool write(const std::string &path, uint64_t &positions, uint64_t &entries);
+
+private:
+	BookBuildOptions opt;
+	std::vector<const QFile*> qfiles;
+	std::unordered_map<uint64_t, std::vector<std::pair<uint16_t,uint32_t>>> recorded; // hash -> (move, visits)
+
+	std::vector<Move> add_position(Board &b, std::vector<BookEntry> &out);
+};
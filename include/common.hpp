@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <atomic>
 #include <array>
 #include <vector>
 #include <string>
@@ -42,21 +43,73 @@ struct Move {
 	uint8_t flags; // bit flags: 1=castle,2=enpassant,4=promotion
 };
 
+constexpr int MAX_MOVES = 256; // no legal chess position has more than 218 moves
+
+// Fixed-capacity, contiguous move buffer meant to live on the stack of hot loops.
+struct MoveList {
+	Move moves[MAX_MOVES];
+	uint32_t count = 0;
+
+	inline void push_back(const Move &m) { moves[count++] = m; }
+	inline void clear() { count = 0; }
+	inline size_t size() const { return count; }
+	inline bool empty() const { return count == 0; }
+	inline Move &operator[](size_t i) { return moves[i]; }
+	inline const Move &operator[](size_t i) const { return moves[i]; }
+	inline Move *begin() { return moves; }
+	inline Move *end() { return moves + count; }
+	inline const Move *begin() const { return moves; }
+	inline const Move *end() const { return moves + count; }
+};
+
 struct GameResult { // reward from white's perspective
 	float reward; // +1 win, 0 draw, -1 loss
 	bool terminal;
 };
 
+// Minimal lock for short critical sections (per-node stats updates).
+struct SpinLock {
+	std::atomic<bool> locked{false};
+	inline void lock() {
+		while (locked.exchange(true, std::memory_order_acquire)) {
+			while (locked.load(std::memory_order_relaxed)) {}
+		}
+	}
+	inline void unlock() { locked.store(false, std::memory_order_release); }
+};
+
+uint64_t next_rng_seed(); // distinct seed per call, derived from the seed_rngs base
+
+// xoshiro256++ seeded through splitmix64: four words of state, a few adds, xors and rotates
+// per draw. Bounded draws use a multiply-shift instead of a modulo.
 struct RNG {
-	std::mt19937_64 gen;
-	RNG() {
-		std::random_device rd;
-		std::seed_seq seq{rd(), (uint32_t)time(nullptr)};
-		gen.seed(seq);
+	uint64_t s[4];
+	RNG() { seed(next_rng_seed()); }
+	explicit RNG(uint64_t seed_) { seed(seed_); }
+	inline void seed(uint64_t x) {
+		for (auto &w : s) {
+			uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			w = z ^ (z >> 31);
+		}
+	}
+	static inline uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+	inline uint64_t u64() {
+		const uint64_t r = rotl(s[0] + s[3], 23) + s[0];
+		const uint64_t t = s[1] << 17;
+		s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return r;
 	}
-	inline double uniform01() { return std::generate_canonical<double, 64>(gen); }
-	inline uint64_t u64() { return gen(); }
+	inline uint32_t below(uint32_t n) { return (uint32_t)(((u64() >> 32) * n) >> 32); } // [0, n)
+	inline float uniform01f() { return (float)(u64() >> 40) * 0x1.0p-24f; } // [0, 1)
+	inline double uniform01() { return (double)(u64() >> 11) * 0x1.0p-53; } // [0, 1)
 };
 
-extern RNG GLOBAL_RNG;
+extern thread_local RNG GLOBAL_RNG; // one generator per thread
+// Reseeds this thread's GLOBAL_RNG and restarts the seed sequence for threads started later,
+// so single-threaded runs repeat exactly. Without it seeds come from std::random_device.
+void seed_rngs(uint64_t seed);
 
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "board.hpp"
+
+// Win/draw/loss tables for KRK, KQK, KBNK and KPK, built by retrograde analysis.
+//
+// Positions are indexed from the strong side's view (colours swapped and the board mirrored
+// vertically when black is the strong side). Pawnless tables fold the board so the strong king
+// lies in the a1-d1-d4 triangle; KPK mirrors the pawn onto files a-d. Each entry is 2 bits, the
+// result for the side to move: 0 draw (also unreachable positions), 1 win, 2 loss. The 50-move
+// rule is not taken into account.
+//
+// File (native byte order): EgtbFileHeader, then the tables in EgtbTable order, each
+// (entries + 3) / 4 bytes. The file is mapped read-only and probed in place.
+
+enum EgtbTable { TB_KRK, TB_KQK, TB_KBNK, TB_KPK, TB_TABLES };
+
+struct EgtbFileHeader {
+	char magic[8]; // "CRLEGTB\0"
+	uint32_t version;
+	uint32_t tables;
+	uint64_t entries[TB_TABLES];
+};
+static_assert(sizeof(EgtbFileHeader) == 48, "on-disk header layout");
+
+constexpr uint32_t EGTB_VERSION = 1;
+
+class Egtb {
+public:
+	Egtb() = default;
+	~Egtb() { close(); }
+	Egtb(const Egtb&) = delete;
+	Egtb &operator=(const Egtb&) = delete;
+
+	bool open(const std::string &path); // false if missing or not a table file of EGTB_VERSION
+	void build(std::ostream &log); // generates all tables in memory (a few seconds)
+	bool save(const std::string &path) const; // via a temporary file and rename
+	void close();
+	bool loaded() const { return data != nullptr; }
+
+	// Result of b for the side to move (1 win, 0 draw, -1 loss) if a table covers it: at most
+	// four pieces, one of the table materials and no castling rights.
+	bool probe(const Board &b, int &wdl) const;
+
+private:
+	void *map = nullptr;
+	size_t map_len = 0;
+	std::vector<uint8_t> owned; // tables built by this process
+	const uint8_t *data = nullptr; // all tables back to back
+	size_t offset[TB_TABLES] = {};
+
+	void set_data(const uint8_t *p);
+};
+
+// Opens path, or builds the tables and saves them there when it cannot be read. A failed save
+// is reported on log and the tables stay in memory.
+void load_or_build_egtb(Egtb &tb, const std::string &path, std::ostream &log);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "egtb.hpp"
+#include "nnue.hpp"
+#include <memory>
+
+// Leaf evaluation for MCTS. An evaluator hands each search thread a LeafBatch; the thread
+// stages the new leaves of up to batch-size simulations and then values them in one call, so
+// evaluators that work on many positions at once can amortise their per-call cost.
+
+// One search thread's staged leaves.
+class LeafBatch {
+public:
+	virtual ~LeafBatch() {}
+	// Stages the position b (which must not be terminal); b is unchanged on return.
+	virtual void add(Board &b) = 0;
+	// Writes the values of the staged positions, in staging order, for their side to move in
+	// [-1, 1], and empties the batch.
+	virtual void evaluate(float *out) = 0;
+};
+
+class LeafEvaluator {
+public:
+	virtual ~LeafEvaluator() {}
+	virtual void attach(Board &b) const {} // prepares a search thread's board before it moves
+	virtual std::unique_ptr<LeafBatch> new_batch(size_t capacity) const = 0;
+};
+
+struct PlayoutOptions {
+	int max_plies = 192; // unfinished playouts score as a draw
+	// Adjudication: once the material margin has stayed at or above adjudicate_cp for
+	// adjudicate_plies consecutive plies, the playout stops and returns margin / (2 * adjudicate_cp),
+	// clamped to [-1, 1]. adjudicate_cp = 0 disables it.
+	int adjudicate_cp = 500;
+	int adjudicate_plies = 8;
+};
+
+// Playout policy: each legal move is scored from the move itself (static exchange on captures,
+// promotions and quiet moves into pawn attacks, plus a bonus for direct checks), so no
+// candidate is made and unmade. The best score is played, with noise breaking ties among
+// quiet moves, except for an epsilon share of uniformly random moves. A batch plays each
+// playout as its leaf is staged. With endgame tables a playout ends as soon as it reaches one.
+class PlayoutEvaluator : public LeafEvaluator {
+public:
+	PlayoutOptions opt;
+	const Egtb *egtb = nullptr;
+
+	explicit PlayoutEvaluator(const PlayoutOptions &o = PlayoutOptions()) : opt(o) {}
+	std::unique_ptr<LeafBatch> new_batch(size_t capacity) const override;
+	// One playout from b; b is left at the playout's last position. Result from white's view.
+	float playout(Board &b) const;
+};
+
+// Material balance only: tanh(margin / MATERIAL_SCALE_CP) for the side to move.
+class MaterialEvaluator : public LeafEvaluator {
+public:
+	static constexpr float MATERIAL_SCALE_CP = 400.0f;
+	std::unique_ptr<LeafBatch> new_batch(size_t capacity) const override;
+};
+
+// The value network. Staging copies the leaf's accumulator; the batch is then run through the
+// network together.
+class NnueEvaluator : public LeafEvaluator {
+public:
+	explicit NnueEvaluator(const Nnue &n) : net(n) {}
+	void attach(Board &b) const override { b.attach_nnue(&net); }
+	std::unique_ptr<LeafBatch> new_batch(size_t capacity) const override;
+
+private:
+	const Nnue &net;
+};
@@ -1,38 +1,132 @@
 #pragma once
 
-#include "board.hpp"
+#include "evaluator.hpp"
+#include "nodetable.hpp"
+#include "qstore.hpp"
+#include "timeman.hpp"
+#include <functional>
+#include <mutex>
 
-struct MCTSNodeKey {
-	uint64_t hash;
-	bool operator==(const MCTSNodeKey &o) const { return hash==o.hash; }
+struct SearchInfo {
+	uint64_t simulations; // completed so far
+	int64_t elapsed_ms;
+	float q; // mean result of the first PV move for the side to move, in [-1, 1]
+	std::vector<Move> pv; // most visited line
 };
 
-struct MCTSNodeData {
-	uint32_t visits;
-	float value_sum; // from current player perspective at node creation
-	std::vector<Move> moves;
-	std::vector<uint32_t> child_visits;
-	std::vector<float> child_values;
-};
-
-struct KeyHasher { size_t operator()(const MCTSNodeKey &k) const { return (size_t)k.hash; } };
-
 class MCTS {
 public:
-	MCTS();
-	Move search_best_move(Board &root, int simulations, float c_puct=1.4f);
-	void set_time_budget_ms(int64_t ms);
+	explicit MCTS(size_t hash_mb = 16); // node table memory budget
+	// threads > 1 runs simulations concurrently on the shared tree. The search ends at the first
+	// of: `simulations` done (<= 0: no limit), the time plan's limits, an early stop, the stop
+	// flag. With neither limit it runs until the stop flag is raised.
+	Move search_best_move(Board &root, int simulations, float c_puct=1.4f, int threads=1);
+	void set_time_budget_ms(int64_t ms); // fixed time per search (<= 0: none), a plan with soft = hard
+	// Clock-managed searches (see timeman.hpp): past plan.soft_ms the search stops as soon as the
+	// root is settled, that is the most visited move also has the best mean among well visited
+	// moves and did not change since the last clock poll; at plan.hard_ms it always stops.
+	void set_time_plan(const TimePlan &plan);
+	// A limited search also ends once the most visited root move leads by more than the
+	// simulations left until the hard limit (at the current rate) or the simulation limit can
+	// overturn, once a settled root leads by more than can be overturned until the soft limit,
+	// or at once with a single legal move. Off by default, so simulation-limited searches
+	// visit the same tree in every run.
+	void set_early_stop(bool enabled);
+	// The search ends early once *flag becomes true (null: never). The owner resets it.
+	void set_stop_flag(const std::atomic<bool> *flag);
+	// Called from the searching thread every interval_ms and once when the search ends.
+	void set_info_callback(std::function<void(const SearchInfo&)> cb, int64_t interval_ms);
+	// One playout from b with the current playout options; b is restored. Result from white's view.
+	float run_playout(Board &b);
+	// Follows the most visited edges from root. Safe to call while a search runs. root_q and
+	// root_visits receive the mean result and visit count of the first move.
+	std::vector<Move> principal_variation(const Board &root, size_t max_len, float *root_q = nullptr, uint32_t *root_visits = nullptr);
+	// Visit counts of root's edges (all zero before any search reached it; empty if not in the table).
+	void root_visits(const Board &root, std::vector<std::pair<Move,uint32_t>> &out);
 	void enable_persistent_q(bool enabled);
-	void load_qtable(const std::string &path);
-	void save_qtable(const std::string &path);
+	void set_playout_options(const PlayoutOptions &opt); // for the built-in playout evaluator
+	// New leaves are valued by ev (null: playouts with the playout options). ev must outlive
+	// the searches that use it.
+	void set_evaluator(const LeafEvaluator *ev);
+	// Each search thread descends up to k simulations (k >= 1), valuing their new leaves in one
+	// evaluator batch before backing them up; pending simulations keep their virtual loss
+	// meanwhile, so the k leaves spread over the tree. k = 1 is the plain sequential search.
+	void set_batch_size(int k);
+	// New leaves and playouts covered by tb are valued from it (null: none). tb must outlive
+	// the searches that use it.
+	void set_egtb(const Egtb *tb);
+	// Maps a binary Q file (see qstore.hpp). False if it could not be read; the Q store is
+	// empty then.
+	bool load_qtable(const std::string &path);
+	// Writes the loaded file plus all updates since, atomically, then maps the result.
+	bool save_qtable(const std::string &path);
+	// Most Q entries kept (0 = unbounded). Least visited entries are evicted first, in memory
+	// once the unsaved updates outgrow it and in the file on save.
+	void set_q_capacity(size_t entries);
+	// Another instance whose Q store is consulted next to our own when seeding new nodes. It is
+	// read without locking, so it must stay idle (and alive) while this instance searches.
+	void attach_qbase(const MCTS *base);
+	void merge_q_into(QTable &dst); // adds this instance's Q entries to dst and clears them
+	void merge_q_from(const QTable &src); // adds src into this instance's Q entries
+	void clear_tree();
+	// Tree reuse: keeps the subtree below root (with its visits) and frees everything else.
+	// Call between searches once the moves since the last search have been played. Returns
+	// the number of nodes kept.
+	size_t reroot(const Board &root);
+	void set_hash_mb(size_t mb); // reallocates (and clears) the node table
+	int hashfull() const { return nodes.hashfull(); }
 
 private:
-	std::unordered_map<MCTSNodeKey, MCTSNodeData, KeyHasher> table;
-	std::unordered_map<uint64_t, std::pair<float,uint32_t>> qtable; // hash->(value_sum,visits)
-	int64_t time_budget_ms;
+	static constexpr uint32_t VIRTUAL_LOSS = 1; // pending visits counted as losses during selection
+
+	static constexpr size_t Q_FLUSH = 1 << 16; // buffered Q updates per thread before a mid-search merge
+	// Limits are checked every few simulations, aiming at one clock read per TIME_POLL_US.
+	static constexpr uint64_t FIRST_POLL = 8;
+	static constexpr double TIME_POLL_US = 500.0;
+
+	struct QUpdate {
+		uint64_t hash;
+		float value;
+	};
+
+	struct RootLeaders {
+		uint32_t edges = 0; // 0 if the root is not in the table
+		uint32_t first = 0, second = 0; // visits of the two most visited edges
+		int best = -1; // index of the first
+		bool settled = false; // best also has the best mean among edges with a quarter of its visits
+	};
+
+	struct PathEntry {
+		uint64_t hash;
+		NodeBucket *bucket;
+		NodeEntry *node;
+		uint32_t edges; // with the key, detects a node replaced while this simulation was below it
+		uint32_t child;
+	};
+
+	NodeTable nodes;
+	QFile qfile; // persisted Q stats, mapped read-only
+	std::mutex qtable_mu;
+	QTable qtable; // Q updates not yet saved to qfile
+	const MCTS *qbase;
+	size_t q_capacity;
+	TimePlan time_plan;
+	bool early_stop;
+	const std::atomic<bool> *stop_flag;
+	std::function<void(const SearchInfo&)> info_cb;
+	int64_t info_interval_ms;
 	bool persistent_q;
+	PlayoutEvaluator playouts;
+	const LeafEvaluator *evaluator;
+	const Egtb *egtb;
+	int batch_size;
+	float c_puct;
 
-	float simulate(Board &b);
-	float playout(Board &b);
+	void add_q_unlocked(uint64_t hash, std::pair<float,uint32_t> &acc) const;
+	int expand(const Board &b); // returns the number of legal moves
+	void mark_live(Board &b, std::vector<NodeEntry*> &live);
+	RootLeaders root_leaders(const Board &root);
+	bool descend(Board &b, std::vector<PathEntry> &path, float &v);
+	void backprop(const std::vector<PathEntry> &path, float v, std::vector<QUpdate> &qbuf);
+	void flush_q(std::vector<QUpdate> &qbuf);
 };
-
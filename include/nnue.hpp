@@ -0,0 +1,73 @@
+#pragma once
+
+#include "board.hpp"
+
+// Small quantized value network in the NNUE style.
+//
+// Inputs are 768 piece-square features per perspective (colour relative to the perspective,
+// piece type, square mirrored vertically for black). The first layer is a sum of int16 weight
+// rows kept incrementally in the Board's accumulator; the side to move's half and the other
+// half are clipped to [0, 127] and feed a 256x32 int8 layer, a second clip and a 32x1 int8
+// output. The output is squashed with tanh into a value for the side to move.
+//
+// Weight file (native byte order): NnueFileHeader, then w1 int16[768][128], b1 int16[128],
+// w2 int8[32][256], b2 int32[32], w3 int8[32], b3 int32. Scales: first layer 127 = 1.0,
+// int8 weights 64 = 1.0, so layer-2 sums and the output are in units of 127*64.
+
+constexpr int NNUE_FEATURES = 768;
+constexpr int NNUE_L2 = 32;
+constexpr int NNUE_INPUTS = 2 * NNUE_HIDDEN; // both perspective halves into layer 2
+constexpr float NNUE_OUT_SCALE = 127.0f * 64.0f; // layer-2 sums and the output
+
+struct NnueFileHeader {
+	char magic[8]; // "CRLNNUE\0"
+	uint32_t version;
+	uint32_t features;
+	uint32_t hidden;
+	uint32_t l2;
+};
+static_assert(sizeof(NnueFileHeader) == 24, "on-disk header layout");
+
+constexpr uint32_t NNUE_VERSION = 1;
+
+class Nnue {
+public:
+	Nnue();
+	bool load(const std::string &path); // false (weights untouched) if missing or mismatched
+	bool save(const std::string &path) const;
+
+	// Value of b for the side to move in [-1, 1]; b must have this network attached.
+	float evaluate(const Board &b) const;
+	// evaluate for n accumulators at once; us[i] is the side to move of acc[i] (0 white, 1 black).
+	void evaluate_batch(const NnueAccumulator *acc, const uint8_t *us, size_t n, float *out) const;
+
+	void refresh(const Board &b, NnueAccumulator &acc) const; // from scratch
+	// out = in plus the feature changes of m played on b (b still before the move)
+	void update(const Board &b, const Move &m, const NnueAccumulator &in, NnueAccumulator &out) const;
+
+	static int feature(int perspective, Piece p, int sq) {
+		int rel = (p > 0 ? 0 : 1) ^ perspective;
+		return (rel * 6 + abs_piece(p) - 1) * 64 + (perspective ? sq ^ 56 : sq);
+	}
+
+	std::vector<int16_t> w1, b1;
+	std::vector<int8_t> w2;
+	std::vector<int32_t> b2;
+	std::vector<int8_t> w3;
+	int32_t b3;
+};
+
+// Training (src/nnue_train.cpp), kept apart so the inference code Board links needs no reader.
+struct NnueTrainOptions {
+	int epochs = 10;
+	int batch = 256;
+	float lr = 1e-3f; // Adam step size
+	uint64_t seed = 1;
+	double validation = 0.05; // share of records held out to report generalisation
+};
+
+// Fits a network to the game results of a training file (see trainfile.hpp) by minimising the
+// squared error between the value and the final result for the side to move, in float with
+// weights clipped to the quantized ranges, then quantizes into net. Progress goes to log.
+// False if the file cannot be read or holds no records.
+bool train_nnue(const std::string &data_path, const NnueTrainOptions &opt, Nnue &net, std::ostream &log);
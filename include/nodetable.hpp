@@ -0,0 +1,79 @@
+#pragma once
+
+#include "common.hpp"
+#include <memory>
+
+// Fixed-size MCTS node storage: an open-addressing table of cache-line buckets for node stats
+// plus a pool for per-edge stats. Edge blocks are bump-allocated; the blocks of evicted nodes go
+// to free lists by size and are reused, split from a larger block if need be. Memory is set
+// once from a megabyte budget and never grows.
+
+struct NodeEntry {
+	uint32_t key; // upper 32 hash bits; the bucket index supplies the low bits
+	uint32_t visits;
+	float value_sum; // from the perspective of the player to move at this node
+	uint32_t edges; // first edge in the pool
+	uint16_t num_edges; // 0 with NODE_USED set means terminal (no legal moves)
+	uint8_t age; // search generation that last touched the node
+	uint8_t flags;
+};
+
+constexpr uint8_t NODE_USED = 1;
+constexpr uint8_t NODE_MARK = 2; // set while collecting the live tree for retain()
+constexpr int BUCKET_ENTRIES = 3;
+
+struct alignas(64) NodeBucket {
+	NodeEntry entries[BUCKET_ENTRIES];
+	SpinLock lock; // guards the entries and the stats of their edges
+};
+static_assert(sizeof(NodeBucket) == 64, "bucket must fill exactly one cache line");
+
+class NodeTable {
+public:
+	static constexpr uint32_t NO_EDGES = 0xFFFFFFFFu;
+
+	explicit NodeTable(size_t mb);
+	void resize(size_t mb);
+	void clear(); // not thread-safe: call between searches
+	void new_search(); // ages entries; flushes the table once the live edges nearly fill the pool
+	// Frees every entry without NODE_MARK and slides the edges of the marked ones (listed in
+	// live) to the front of the pool. Not thread-safe: call between searches.
+	void retain(std::vector<NodeEntry*> &live);
+
+	inline NodeBucket &bucket(uint64_t hash) { return buckets[hash & bucket_mask]; }
+	// find/insert require the bucket lock. insert reuses an empty slot or evicts the least
+	// valuable entry (stale generations first, then fewest visits), freeing its edges; the entry
+	// comes back zeroed.
+	NodeEntry *find(NodeBucket &b, uint64_t hash) const;
+	int other_keys(const NodeBucket &b, uint64_t hash) const; // used slots holding another key (stats)
+	NodeEntry *insert(NodeBucket &b, uint64_t hash);
+	// Drops the stale entry of b with the most edges, freeing them. False if b has none.
+	bool release_stale(NodeBucket &b);
+
+	uint32_t alloc_edges(uint32_t n); // NO_EDGES when the pool is exhausted
+	void free_edges(uint32_t e, uint32_t n); // returns a block no entry refers to any more
+	inline Move *edge_moves(uint32_t e) { return moves.get() + e; }
+	inline uint32_t *edge_visits(uint32_t e) { return visits.get() + e; }
+	inline float *edge_values(uint32_t e) { return values.get() + e; }
+
+	uint8_t generation() const { return gen; }
+	int hashfull() const; // live edges in permille of the pool
+
+private:
+	std::unique_ptr<NodeBucket[]> buckets;
+	size_t bucket_mask;
+	std::unique_ptr<Move[]> moves;
+	std::unique_ptr<uint32_t[]> visits;
+	std::unique_ptr<float[]> values;
+	uint32_t edge_capacity;
+	std::atomic<uint32_t> edges_used; // bump pointer, never past edge_capacity
+	// Free blocks by size, linked through the first visit slot of each block (NO_EDGES ends a
+	// list). edges_free lets allocations skip the lock while nothing has been freed.
+	SpinLock free_lock;
+	uint32_t free_head[MAX_MOVES + 1];
+	std::atomic<uint32_t> edges_free;
+	uint8_t gen;
+
+	uint32_t reuse_edges(uint32_t n);
+	void reset_free();
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "board.hpp"
+
+struct PerftOptions {
+	int threads = 1; // root moves are split across this many workers
+	size_t hash_mb = 0; // subtree-count cache keyed by Zobrist hash; 0 disables it
+	bool divide = false; // print the node count below each root move
+};
+
+struct PerftResult {
+	uint64_t nodes;
+	double seconds;
+};
+
+uint64_t perft(Board &b, int depth); // plain recursive count, bulk-counted at the last ply
+PerftResult run_perft(const Board &root, int depth, const PerftOptions &opt, std::ostream &out);
+// Runs the built-in reference positions; depth_cap > 0 limits each entry's depth. False on any mismatch.
+bool run_perft_suite(const PerftOptions &opt, std::ostream &out, int depth_cap = 0);
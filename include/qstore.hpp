@@ -0,0 +1,61 @@
+#pragma once
+
+#include "common.hpp"
+
+// Persistent Q statistics keyed by Zobrist hash.
+//
+// On disk (native byte order): a QFileHeader followed by `capacity` QRecords forming an
+// open-addressing table with linear probing, kept at most half full. Slot i holds hashes
+// that probe from (hash & (capacity-1)); hash 0 marks an empty slot. The file is mapped
+// read-only and probed in place, so opening costs the same regardless of size.
+
+using QTable = std::unordered_map<uint64_t, std::pair<float,uint32_t>>; // hash->(value_sum,visits)
+
+struct QRecord {
+	uint64_t hash;
+	float value_sum;
+	uint32_t visits;
+};
+static_assert(sizeof(QRecord) == 16, "on-disk record layout");
+
+struct QFileHeader {
+	char magic[8]; // "CRLQTAB\0"
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t capacity; // slots, power of two
+	uint64_t count; // occupied slots
+};
+static_assert(sizeof(QFileHeader) == 32, "on-disk header layout");
+
+constexpr uint32_t QFILE_VERSION = 2; // v1 files were keyed by per-launch random Zobrist keys
+
+class QFile {
+public:
+	QFile() = default;
+	~QFile() { close(); }
+	QFile(const QFile&) = delete;
+	QFile &operator=(const QFile&) = delete;
+
+	bool open(const std::string &path); // false if missing or not a valid file of QFILE_VERSION
+	void close();
+	const QRecord *probe(uint64_t hash) const; // nullptr when absent or nothing is open
+	uint64_t size() const { return hdr ? hdr->count : 0; }
+	uint64_t capacity() const { return hdr ? hdr->capacity : 0; }
+	const QRecord *records() const { return recs; } // capacity() slots, empty ones have hash 0
+
+private:
+	void *map = nullptr;
+	size_t map_len = 0;
+	const QFileHeader *hdr = nullptr;
+	const QRecord *recs = nullptr;
+};
+
+// Writes base (may be null) plus delta to path via a temporary file and rename, so readers
+// and crashes only ever see the old or the new complete file. max_entries > 0 keeps only that
+// many entries, the most visited ones. False on I/O failure.
+bool write_qfile(const std::string &path, const QFile *base, const QTable &delta, uint64_t max_entries = 0);
+// Drops the least visited entries of q until at most keep remain. An entry's visits include
+// its visits in base (may be null), so updates to positions the file already knows well stay.
+void prune_qtable(QTable &q, size_t keep, const QFile *base = nullptr);
+// Reads the legacy whitespace-separated "hash value_sum visits" text format into q (adding).
+bool read_qtext(const std::string &path, QTable &q);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "mcts.hpp"
+#include "trainfile.hpp"
+
+struct SelfPlayOptions {
+	int games = 500;
+	int workers = 1;
+	int simulations = 48; // per move
+	// clock_ms > 0 plays timed games: each side starts with clock_ms and gains increment_ms per
+	// move, every search gets a plan_move_time plan with early stop instead of the simulation
+	// count, and a side whose clock runs out loses. Timed games vary with machine load.
+	int64_t clock_ms = 0, increment_ms = 0;
+	int max_plies = 512; // unfinished games are not counted in the tallies
+	uint64_t seed = 0;
+	size_t hash_mb = 16; // node table per worker
+	PlayoutOptions playout;
+	const LeafEvaluator *evaluator = nullptr; // null: playouts with the options above
+	int batch = 1; // leaves per evaluator batch, see MCTS::set_batch_size
+	const Egtb *egtb = nullptr; // endgame tables for leaves and playouts
+	TrainWriter *record = nullptr; // every position of each finished game, with its root visits
+};
+
+struct SelfPlayStats {
+	int white_wins = 0, black_wins = 0, draws = 0;
+	int time_losses = 0; // timed games lost on the clock, counted in the wins as well
+	int64_t worst_overrun_ms = 0; // timed games: furthest a search ran past its hard limit
+	double seconds = 0;
+};
+
+// Plays opt.games games on opt.workers threads. Each worker has its own search tree and RNG.
+// Every game reads store's Q entries as they were at the start and is seeded from opt.seed and
+// its index, so results are reproducible for a given seed and worker count. Workers fold their Q
+// updates into private accumulators, which are merged into store once all games finish.
+SelfPlayStats run_selfplay(MCTS &store, const SelfPlayOptions &opt, std::ostream &progress);
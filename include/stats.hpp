@@ -0,0 +1,68 @@
+#pragma once
+
+#include "common.hpp"
+
+// Hot-path instrumentation, compiled in with -DCHESS_STATS. Every thread counts into its own
+// block, so nothing is shared on the hot path; stats_dump adds up the blocks of live and
+// finished threads. Without CHESS_STATS the macros expand to nothing and no storage exists.
+
+enum StatTimer { // inclusive: playout and expand contain the movegen/make time they trigger; eval times the evaluator batches
+	TM_MOVEGEN, TM_MAKE, TM_UNMAKE, TM_TERMINAL, TM_PLAYOUT, TM_EVAL, TM_EXPAND, TM_Q_SEED, TM_Q_FLUSH, STAT_TIMERS
+};
+enum StatCounter {
+	ST_SIMULATIONS, ST_TABLE_HIT, ST_TABLE_MISS, ST_TABLE_EVICT, ST_TABLE_COLLISIONS, ST_EDGES, ST_PLAYOUT_PLIES, ST_EGTB_HITS, STAT_COUNTERS
+};
+constexpr int STAT_DEPTHS = 64; // leaf depth histogram; deeper leaves land in the last bucket
+
+struct SearchStats {
+	uint64_t calls[STAT_TIMERS];
+	uint64_t ticks[STAT_TIMERS];
+	uint64_t count[STAT_COUNTERS];
+	uint64_t depth[STAT_DEPTHS];
+};
+
+#ifdef CHESS_STATS
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+inline uint64_t stat_ticks() { return __rdtsc(); }
+#elif defined(__aarch64__)
+inline uint64_t stat_ticks() { uint64_t v; asm volatile("mrs %0, cntvct_el0" : "=r"(v)); return v; }
+#else
+#include <chrono>
+inline uint64_t stat_ticks() { return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count(); }
+#endif
+
+SearchStats &thread_stats(); // this thread's block, registered on first use
+
+struct StatScope {
+	StatTimer t;
+	uint64_t t0;
+	explicit StatScope(StatTimer t_) : t(t_), t0(stat_ticks()) {}
+	~StatScope() {
+		SearchStats &s = thread_stats();
+		++s.calls[t];
+		s.ticks[t] += stat_ticks() - t0;
+	}
+};
+
+void stats_reset(); // zeroes every block and restarts the wall clock; call between searches
+void stats_dump(std::ostream &out); // summary since the last reset; call between searches
+
+#define STAT_TIMER(t) StatScope stat_scope_(t)
+#define STAT_ADD(c, n) (thread_stats().count[c] += (uint64_t)(n))
+#define STAT_DEPTH(d) (++thread_stats().depth[std::min<size_t>((size_t)(d), STAT_DEPTHS - 1)])
+#define STAT_ONLY(...) __VA_ARGS__
+#define STATS_RESET() stats_reset()
+#define STATS_DUMP(out) stats_dump(out)
+
+#else
+
+#define STAT_TIMER(t) ((void)0)
+#define STAT_ADD(c, n) ((void)0)
+#define STAT_DEPTH(d) ((void)0)
+#define STAT_ONLY(...)
+#define STATS_RESET() ((void)0)
+#define STATS_DUMP(out) ((void)0)
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "board.hpp"
+
+// Per-move time allocation for games played on a clock.
+
+struct TimeControl {
+	int64_t time_left_ms = -1; // the mover's clock, < 0: none
+	int64_t increment_ms = 0;
+	int moves_to_go = 0; // moves until the next time control, 0: sudden death
+	int64_t overhead_ms = 50; // never planned closer than this to the flag
+};
+
+// A search may stop past soft_ms once its root is settled and always stops at hard_ms.
+// 0 means no limit.
+struct TimePlan {
+	int64_t soft_ms = 0;
+	int64_t hard_ms = 0;
+};
+
+constexpr int64_t HARD_STRETCH = 4;
+constexpr int64_t HARD_SHARE = 4;
+
+// The soft limit is an even share of the clock over the moves expected until the control (20
+// in a bare endgame up to 40 with all pieces on the board, or moves_to_go) plus three quarters
+// of the increment. The hard limit gives an unsettled root up to HARD_STRETCH times that, but
+// never more than 1/HARD_SHARE of the clock.
+TimePlan plan_move_time(const TimeControl &tc, const Board &b);
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "board.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Self-play training records.
+//
+// On disk (native byte order): a TrainFileHeader, then records back to back. Each record is a
+// TrainRecordHead followed by num_moves TrainMove entries, one per visited root move:
+//   board: 64 nibbles, piece code + 6 per square (a1 low nibble of byte 0, h8 high of byte 31)
+//   flags: bit 0 white to move, bits 1-4 castling rights
+//   result: final game result from white's view (-1, 0, 1)
+//   visits: root visit counts, scaled down to fit 16 bits if the largest one does not
+// Records are only appended, so files from several runs can be concatenated.
+
+struct TrainFileHeader {
+	char magic[8]; // "CRLTRAIN"
+	uint32_t version;
+	uint32_t reserved;
+};
+static_assert(sizeof(TrainFileHeader) == 16, "on-disk header layout");
+
+constexpr uint32_t TRAINFILE_VERSION = 1;
+
+#pragma pack(push, 1)
+struct TrainRecordHead {
+	uint8_t board[32];
+	uint8_t flags;
+	int8_t ep_square; // -1 if none
+	int8_t result;
+	uint8_t num_moves;
+	uint16_t halfmove_clock;
+};
+struct TrainMove {
+	uint16_t move; // from | to << 6 | promotion type (0 none, 2..5 knight..queen) << 12
+	uint16_t visits;
+};
+#pragma pack(pop)
+static_assert(sizeof(TrainRecordHead) == 38 && sizeof(TrainMove) == 4, "on-disk record layout");
+
+// A move in 16 bits, as stored in TrainMove.
+uint16_t pack_move(const Move &m);
+
+// Appends one record for b with the given root visits to buf (result 0) and returns the offset
+// of its result byte, to be patched with set_train_result once the game is over.
+size_t append_train_record(std::vector<uint8_t> &buf, const Board &b, const std::vector<std::pair<Move,uint32_t>> &visits);
+inline void set_train_result(std::vector<uint8_t> &buf, size_t at, int8_t result) { buf[at] = (uint8_t)result; }
+
+// Takes filled buffers from any number of threads and writes them on one background thread, so
+// producers only pay for a buffer swap. At most `queue_limit` buffers wait; submit blocks beyond
+// that instead of growing memory.
+class TrainWriter {
+public:
+	static constexpr size_t CHUNK_BYTES = 1 << 20; // buffer size producers should submit at
+
+	TrainWriter() = default;
+	~TrainWriter() { close(); }
+	TrainWriter(const TrainWriter&) = delete;
+	TrainWriter &operator=(const TrainWriter&) = delete;
+
+	// Appends to path, writing the header if the file is new. False if it cannot be opened or
+	// holds something other than a TRAINFILE_VERSION file.
+	bool open(const std::string &path, size_t queue_limit = 8);
+	void submit(std::vector<uint8_t> &buf); // takes the contents; buf comes back empty
+	bool close(); // drains the queue; false if any write failed
+	uint64_t bytes_written() const { return written; }
+
+private:
+	FILE *file = nullptr;
+	std::thread writer;
+	std::mutex mu;
+	std::condition_variable cv;
+	std::deque<std::vector<uint8_t>> queue;
+	size_t limit = 8;
+	bool closing = false;
+	bool failed = false;
+	std::atomic<uint64_t> written{0};
+
+	void run();
+};
+
+struct TrainSample {
+	Board board;
+	std::vector<std::pair<Move,uint32_t>> visits;
+	int8_t result; // from white's view
+};
+
+// Sequential reader over a mapped training file.
+class TrainReader {
+public:
+	TrainReader() = default;
+	~TrainReader() { close(); }
+	TrainReader(const TrainReader&) = delete;
+	TrainReader &operator=(const TrainReader&) = delete;
+
+	bool open(const std::string &path); // false if missing or not a TRAINFILE_VERSION file
+	void close();
+	// Decodes the next record into out; false at the end or on a truncated or corrupt record,
+	// which corrupt() then tells apart.
+	bool next(TrainSample &out);
+	void rewind() { pos = sizeof(TrainFileHeader); }
+	bool corrupt() const { return map && pos != map_len; } // after next() returned false
+	size_t offset() const { return pos; } // byte offset of the next (or the bad) record
+
+private:
+	void *map = nullptr;
+	size_t map_len = 0;
+	size_t pos = 0;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "common.hpp"
+
+constexpr float UCB_UNVISITED = 1e9f; // score of an edge without visits (finite under -ffast-math)
+
+// Index of the edge maximising value/visits + c_sqrt_parent/(1+visits) over n structure-of-arrays
+// edge stats, unvisited edges scoring UCB_UNVISITED. Ties go to the lowest index (MCTS::expand
+// shuffles the edges, so among unvisited ones that is a random pick). c_sqrt_parent is
+// c_puct * sqrt(parent visits), computed once per node by the caller. Uses AVX2 or NEON when the
+// build targets them, scalar code otherwise.
+size_t select_ucb(const uint32_t *visits, const float *values, size_t n, float c_sqrt_parent);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "book.hpp"
+#include "mcts.hpp"
+
+struct UciSettings {
+	int threads = 1;
+	size_t hash_mb = 64;
+	std::string qfile; // Q-table loaded by setoption QFile and saved by the caller on exit
+	const Book *book = nullptr; // answers go at once when it has a confident move (null: none)
+	BookOptions book_opt;
+	bool own_book = true; // setoption OwnBook
+};
+
+// Runs the UCI protocol on in/out until "quit" or end of input. Searches run on a background
+// thread, so "stop" and "isready" are answered while one is in progress. settings holds the
+// values the GUI chose once the loop returns.
+void uci_loop(MCTS &mcts, UciSettings &settings, std::istream &in, std::ostream &out);
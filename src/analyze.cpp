@@ -0,0 +1,134 @@
+#include "analyze.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <memory>
+#include <thread>
+
+// EPD carries four position fields followed by opcodes; a FEN adds the two move counters.
+static bool parse_epd(const std::string &line, Board &b) {
+	std::istringstream in(line);
+	std::string tok, fen;
+	for (int i=0; i<4 && in >> tok; ++i) fen += (i ? " " : "") + tok;
+	for (int i=0; i<2 && in >> tok && tok.find_first_not_of("0123456789") == std::string::npos; ++i) fen += " " + tok;
+	return b.set_fen(fen);
+}
+
+AnalyzeStats run_analyze(std::istream &in, std::ostream &out, const AnalyzeOptions &opt) {
+	const int workers = std::max(1, opt.workers);
+	const uint64_t window = (uint64_t)workers * 4; // positions in flight, read but not yet written
+	auto start = std::chrono::steady_clock::now();
+
+	// Ring of in-flight positions indexed by sequence number. The reader fills slot read % window
+	// once the writer has freed it, workers claim slots in order, and the writer drains them in
+	// order as they complete.
+	struct Slot {
+		uint64_t line_no;
+		std::string text; // input line, then the result line
+		bool done;
+	};
+	std::vector<Slot> ring(window);
+	std::mutex mu;
+	std::condition_variable cv;
+	uint64_t read = 0, claimed = 0, written = 0;
+	bool eof = false;
+	std::atomic<uint64_t> errors{0};
+
+	auto worker = [&]() {
+		std::unique_ptr<MCTS> mcts(new MCTS(opt.hash_mb));
+		mcts->enable_persistent_q(false);
+		mcts->set_playout_options(opt.playout);
+		mcts->set_evaluator(opt.evaluator);
+		mcts->set_batch_size(opt.batch);
+		mcts->set_egtb(opt.egtb);
+		mcts->set_time_budget_ms(opt.movetime_ms);
+		while (true) {
+			uint64_t seq;
+			std::string line;
+			uint64_t line_no;
+			{
+				std::unique_lock<std::mutex> lk(mu);
+				cv.wait(lk, [&]() { return claimed < read || eof; });
+				if (claimed == read) return;
+				seq = claimed++;
+				line_no = ring[seq % window].line_no;
+				line.swap(ring[seq % window].text);
+			}
+			std::ostringstream ss;
+			ss << line_no;
+			Board b;
+			if (!parse_epd(line, b)) {
+				ss << " error " << line;
+				++errors;
+			} else {
+				GLOBAL_RNG.seed(opt.seed ^ (line_no * 0x9E3779B97F4A7C15ull));
+				mcts->clear_tree();
+				Move best = mcts->search_best_move(b, opt.simulations, 1.2f);
+				float q = 0.0f;
+				uint32_t visits = 0;
+				if (best.from == best.to) {
+					GameResult g = b.evaluate_terminal(); // no legal moves: report the verdict
+					q = g.reward == 0.0f ? 0.0f : b.white_to_move ? g.reward : -g.reward;
+				} else {
+					mcts->principal_variation(b, 1, &q, &visits);
+				}
+				ss << ' ' << (best.from == best.to ? std::string("0000") : move_to_uci(best)) << ' ' << visits
+					<< ' ' << std::fixed << std::setprecision(4) << q << ' ' << b.fen();
+			}
+			std::lock_guard<std::mutex> lk(mu);
+			ring[seq % window].text = ss.str();
+			ring[seq % window].done = true;
+			cv.notify_all();
+		}
+	};
+	auto writer = [&]() {
+		while (true) {
+			std::string result;
+			{
+				std::unique_lock<std::mutex> lk(mu);
+				cv.wait(lk, [&]() { return (written < read && ring[written % window].done) || (eof && written == read); });
+				if (written == read) return;
+				Slot &s = ring[written % window];
+				result.swap(s.text);
+				s.done = false;
+				++written;
+				cv.notify_all(); // a slot came free for the reader
+			}
+			out << result << '\n';
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (int w=0; w<workers; ++w) pool.emplace_back(worker);
+	std::thread writer_thread(writer);
+	std::string line;
+	uint64_t line_no = 0;
+	while (std::getline(in, line)) {
+		++line_no;
+		line.erase(line.find_last_not_of(" \t\r") + 1); // CRLF files leave a '\r' behind
+		size_t first = line.find_first_not_of(" \t");
+		if (first == std::string::npos || line[first] == '#') continue;
+		std::unique_lock<std::mutex> lk(mu);
+		cv.wait(lk, [&]() { return read - written < window; });
+		Slot &s = ring[read % window];
+		s.line_no = line_no;
+		s.text = line;
+		s.done = false;
+		++read;
+		cv.notify_all();
+	}
+	{
+		std::lock_guard<std::mutex> lk(mu);
+		eof = true;
+		cv.notify_all();
+	}
+	for (auto &th : pool) th.join();
+	writer_thread.join();
+	out.flush();
+
+	AnalyzeStats st;
+	st.positions = read;
+	st.errors = errors;
+	st.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return st;
+}
@@ -0,0 +1,178 @@
+#include "bench.hpp"
+#include "perft.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <sys/resource.h>
+
+static const char *SCALING_FENS[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+};
+
+void bench_thread_scaling(int simulations, std::ostream &out) {
+	double base_rate = 0;
+	for (int threads : {1, 2, 4, 8, 16}) {
+		double secs = 0;
+		int sims = 0;
+		for (const char *fen : SCALING_FENS) {
+			Board b;
+			b.set_fen(fen);
+			std::unique_ptr<MCTS> mcts(new MCTS()); // fresh tree so every run does the same work
+			mcts->enable_persistent_q(false);
+			auto start = std::chrono::steady_clock::now();
+			mcts->search_best_move(b, simulations, 1.2f, threads);
+			secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			sims += simulations;
+		}
+		double rate = sims / std::max(secs, 1e-9);
+		if (threads == 1) base_rate = rate;
+		out << "threads " << threads << ": " << (uint64_t)rate << " sims/s, speedup " << rate / base_rate << "x\n";
+	}
+}
+
+void bench_batch_sizes(int simulations, const LeafEvaluator *ev, int threads, std::ostream &out) {
+	double base_rate = 0;
+	for (int k : {1, 2, 4, 8, 16, 32}) {
+		double secs = 0;
+		int sims = 0;
+		for (const char *fen : SCALING_FENS) {
+			Board b;
+			b.set_fen(fen);
+			std::unique_ptr<MCTS> mcts(new MCTS());
+			mcts->enable_persistent_q(false);
+			mcts->set_evaluator(ev);
+			mcts->set_batch_size(k);
+			auto start = std::chrono::steady_clock::now();
+			mcts->search_best_move(b, simulations, 1.2f, threads);
+			secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			sims += simulations;
+		}
+		double rate = sims / std::max(secs, 1e-9);
+		if (k == 1) base_rate = rate;
+		out << "batch " << k << ": " << (uint64_t)rate << " sims/s, speedup " << rate / base_rate << "x\n";
+	}
+}
+
+struct BenchPosition {
+	const char *fen;
+	int perft_depth;
+};
+
+static const BenchPosition BENCH_SUITE[] = {
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5},
+	{"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4},
+	{"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5},
+	{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4},
+	{"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4},
+	{"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4},
+};
+static constexpr uint64_t BENCH_SEED = 20240601;
+static constexpr int BENCH_MOVEGEN_CALLS = 200000; // per position
+static constexpr int BENCH_PLAYOUTS = 1000; // per position
+static constexpr int BENCH_SIMULATIONS = 5000; // per position
+
+static double seconds_since(std::chrono::steady_clock::time_point t) {
+	return std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count());
+}
+
+BenchResult run_bench(std::ostream &log) {
+	BenchResult r;
+	auto start = std::chrono::steady_clock::now();
+	std::vector<Board> boards;
+	for (const BenchPosition &p : BENCH_SUITE) {
+		boards.emplace_back();
+		boards.back().set_fen(p.fen);
+	}
+
+	uint64_t calls = 0, moves = 0;
+	auto t = std::chrono::steady_clock::now();
+	MoveList ml;
+	for (const Board &b : boards) {
+		for (int i=0; i<BENCH_MOVEGEN_CALLS; ++i) { b.generate_legal_moves(ml); moves += ml.size(); }
+		calls += BENCH_MOVEGEN_CALLS;
+	}
+	r.movegen_per_s = calls / seconds_since(t);
+	log << "movegen   " << (uint64_t)r.movegen_per_s << " calls/s (" << moves / calls << " moves/call)\n";
+
+	uint64_t nodes = 0;
+	t = std::chrono::steady_clock::now();
+	for (size_t i=0; i<boards.size(); ++i) nodes += perft(boards[i], BENCH_SUITE[i].perft_depth);
+	r.perft_nps = nodes / seconds_since(t);
+	log << "perft     " << (uint64_t)r.perft_nps << " nodes/s (" << nodes << " nodes)\n";
+
+	MCTS runner(1);
+	runner.enable_persistent_q(false);
+	seed_rngs(BENCH_SEED);
+	double reward = 0;
+	t = std::chrono::steady_clock::now();
+	for (Board &b : boards) {
+		for (int i=0; i<BENCH_PLAYOUTS; ++i) reward += runner.run_playout(b);
+	}
+	r.playouts_per_s = boards.size() * BENCH_PLAYOUTS / seconds_since(t);
+	log << "playouts  " << (uint64_t)r.playouts_per_s << " /s (mean result " << reward / (boards.size() * BENCH_PLAYOUTS) << ")\n";
+
+	double search_secs = 0;
+	for (Board &b : boards) {
+		std::unique_ptr<MCTS> mcts(new MCTS(64));
+		mcts->enable_persistent_q(false);
+		seed_rngs(BENCH_SEED);
+		t = std::chrono::steady_clock::now();
+		mcts->search_best_move(b, BENCH_SIMULATIONS, 1.2f, 1);
+		search_secs += seconds_since(t);
+	}
+	r.sims_per_s = boards.size() * BENCH_SIMULATIONS / search_secs;
+	log << "search    " << (uint64_t)r.sims_per_s << " sims/s\n";
+
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	r.peak_rss_mb = ru.ru_maxrss / 1024.0; // kilobytes on Linux
+	r.seconds = seconds_since(start);
+	log << "peak rss  " << r.peak_rss_mb << " MB, total " << r.seconds << " s\n";
+	return r;
+}
+
+static const struct {
+	const char *key;
+	double BenchResult::*field;
+} BENCH_FIELDS[] = {
+	{"movegen_per_s", &BenchResult::movegen_per_s}, {"perft_nps", &BenchResult::perft_nps},
+	{"playouts_per_s", &BenchResult::playouts_per_s}, {"sims_per_s", &BenchResult::sims_per_s},
+	{"peak_rss_mb", &BenchResult::peak_rss_mb}, {"seconds", &BenchResult::seconds},
+};
+static constexpr int BENCH_RATES = 4; // leading fields compared for regressions
+
+std::string bench_to_json(const BenchResult &r) {
+	std::ostringstream ss;
+	ss.precision(10);
+	ss << "{";
+	for (const auto &f : BENCH_FIELDS) ss << (&f == BENCH_FIELDS ? "" : ", ") << '"' << f.key << "\": " << r.*f.field;
+	ss << "}";
+	return ss.str();
+}
+
+bool bench_from_json(const std::string &path, BenchResult &out) {
+	std::ifstream in(path);
+	if (!in) return false;
+	std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	for (const auto &f : BENCH_FIELDS) {
+		size_t at = text.find(std::string("\"") + f.key + "\"");
+		if (at == std::string::npos || (at = text.find(':', at)) == std::string::npos) return false;
+		out.*f.field = std::strtod(text.c_str() + at + 1, nullptr);
+	}
+	return true;
+}
+
+bool bench_compare(const BenchResult &cur, const BenchResult &base, double threshold_pct, std::ostream &out) {
+	bool ok = true;
+	for (int i=0; i<BENCH_RATES; ++i) {
+		const auto &f = BENCH_FIELDS[i];
+		double was = base.*f.field, now = cur.*f.field;
+		double change = was > 0 ? (now / was - 1.0) * 100.0 : 0.0;
+		bool regressed = change < -threshold_pct;
+		ok = ok && !regressed;
+		out << f.key << ": " << (uint64_t)now << " vs " << (uint64_t)was << " (" << (change >= 0 ? "+" : "") << change << "%)" << (regressed ? " REGRESSION" : "") << '\n';
+	}
+	out << "peak_rss_mb: " << cur.peak_rss_mb << " vs " << base.peak_rss_mb << " (not gated)\n";
+	return ok;
+}
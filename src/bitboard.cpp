@@ -0,0 +1,131 @@
+#include "bitboard.hpp"
+
+uint64_t PAWN_ATTACKS[2][64];
+uint64_t KNIGHT_ATTACKS[64];
+uint64_t KING_ATTACKS[64];
+Magic ROOK_MAGICS[64];
+Magic BISHOP_MAGICS[64];
+uint64_t BETWEEN_BB[64][64];
+uint64_t LINE_BB[64][64];
+
+static uint64_t ROOK_TABLE[0x19000];
+static uint64_t BISHOP_TABLE[0x1480];
+
+// Fancy magics (shift = 64 - relevant bits). Unused when PEXT is available.
+static const uint64_t ROOK_MAGIC_NUMBERS[64] = {
+	0x1080004008801020ull, 0x0840092002c03000ull, 0x1900200010400900ull, 0x0880100008000480ull,
+	0x4200100420080200ull, 0x8100020100080400ull, 0x0200040110886200ull, 0x0200008040220411ull,
+	0x0404800084400220ull, 0x0000401000402000ull, 0x0086001081220440ull, 0x0408800800100280ull,
+	0x000a001201040820ull, 0x8848800200840080ull, 0x4001000100040200ull, 0x0442000102105084ull,
+	0x9080010020804100ull, 0x0040404000201009ull, 0x0000808010002009ull, 0x2200090021d00100ull,
+	0x0008008008040080ull, 0x0004004002010040ull, 0x0011040008015042ull, 0x00000a0001768104ull,
+	0x0000800080204009ull, 0x2010004140002001ull, 0x9800200280100080ull, 0x1000100080080080ull,
+	0x0442000a00049020ull, 0x2100040080020080ull, 0x0800120400900148ull, 0x0010040a00128541ull,
+	0x2800804000800030ull, 0x1010002000400041ull, 0x4000200011004100ull, 0x0610008410800800ull,
+	0x0400802402800800ull, 0xc100020080800400ull, 0x0002000802000401ull, 0x0182085882000401ull,
+	0x0220204000808000ull, 0x2860100040024022ull, 0x0001002004110040ull, 0x99101042000a0020ull,
+	0x0004080004008080ull, 0x0010040002008080ull, 0x2012004881020004ull, 0x8300842444820011ull,
+	0x0088403882010200ull, 0x0820400080210100ull, 0x0110910040a00300ull, 0x0801100280080480ull,
+	0x0242009008200600ull, 0x1002000489500200ull, 0x0040800200010080ull, 0x0091800041000080ull,
+	0x0000209300488001ull, 0x04c1002414824001ull, 0x020020000b001041ull, 0x7000100004200901ull,
+	0x8002002004100802ull, 0x30010002084c0007ull, 0x0888221800813004ull, 0x4000002840840112ull,
+};
+
+static const uint64_t BISHOP_MAGIC_NUMBERS[64] = {
+	0xa010041108003100ull, 0x006082020a002900ull, 0x6810010619200000ull, 0x08281a0520000408ull,
+	0x0001104001000400ull, 0x0018901008048400ull, 0x00040a0210245280ull, 0x000200210808a402ull,
+	0x9140048410821200ull, 0x0800091010820041ull, 0x20504804832202c0ull, 0x0100091401081000ull,
+	0x8021011140000012ull, 0x0810020804450400ull, 0x208b0542109008a2ull, 0x0080084a08040204ull,
+	0x0040e2a80811244cull, 0x2505022008008108ull, 0x0430220100420040ull, 0x010a040420220040ull,
+	0x1105000290400000ull, 0x0093001200822120ull, 0x4000a62048043004ull, 0x280120048a015004ull,
+	0x006090002a020814ull, 0x44042000240800d0ull, 0x01102800040a4400ull, 0x1004080080220040ull,
+	0x0001001011004024ull, 0x0010044000805040ull, 0x0914041200820100ull, 0x0004821012821480ull,
+	0x0024040500c05021ull, 0x0088611002080200ull, 0x0116080a00040020ull, 0x4000020080080080ull,
+	0x2450450140840040ull, 0x0000880201484100ull, 0x0222020404020092ull, 0x8081110600002e00ull,
+	0x2842101105000801ull, 0x1100809008001025ull, 0x00020202221c0400ull, 0x0422014022009020ull,
+	0x0210046102100c00ull, 0xc004008082029102ull, 0x00aa461801101200ull, 0x0404080080201108ull,
+	0x020542108c205002ull, 0x0410544804100100ull, 0x0040910841100000ull, 0x0400200042021100ull,
+	0x00004204850400c0ull, 0x0200100410a42102ull, 0x1040020801210102ull, 0x0805040410420000ull,
+	0x2884804130100200ull, 0x800c262201242000ull, 0x1058000194108800ull, 0x0014221054420204ull,
+	0x0104000012a02200ull, 0x0200881003300100ull, 0x0140400202840100ull, 0x0402020801010201ull,
+};
+
+static const int ROOK_DIRS[4][2] = {{1,0},{-1,0},{0,1},{0,-1}};
+static const int BISHOP_DIRS[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
+
+static uint64_t step_set(int sq, const int (*offs)[2], int n) {
+	uint64_t b = 0;
+	int r = sq >> 3, f = sq & 7;
+	for (int i=0; i<n; ++i) {
+		int rr = r + offs[i][0], ff = f + offs[i][1];
+		if (rr>=0 && rr<8 && ff>=0 && ff<8) b |= square_bb((rr << 3) | ff);
+	}
+	return b;
+}
+
+static uint64_t slide_set(int sq, uint64_t occ, const int (*dirs)[2]) {
+	uint64_t b = 0;
+	for (int i=0; i<4; ++i) {
+		int rr = (sq >> 3) + dirs[i][0], ff = (sq & 7) + dirs[i][1];
+		while (rr>=0 && rr<8 && ff>=0 && ff<8) {
+			uint64_t s = square_bb((rr << 3) | ff);
+			b |= s;
+			if (occ & s) break;
+			rr += dirs[i][0]; ff += dirs[i][1];
+		}
+	}
+	return b;
+}
+
+static void init_magics(Magic *magics, uint64_t *table, const uint64_t *numbers, const int (*dirs)[2]) {
+	uint64_t *next = table;
+	for (int sq=0; sq<64; ++sq) {
+		Magic &m = magics[sq];
+		// board edges are never relevant blockers, except on the slider's own rank/file
+		uint64_t edges = ((RANK_1_BB | RANK_8_BB) & ~(RANK_1_BB << (8 * (sq >> 3))))
+			| ((FILE_A_BB | FILE_H_BB) & ~(FILE_A_BB << (sq & 7)));
+		m.mask = slide_set(sq, 0, dirs) & ~edges;
+		m.magic = numbers[sq];
+		m.shift = 64 - popcount(m.mask);
+		m.attacks = next;
+		uint64_t sub = 0;
+		do { // enumerate all blocker subsets (Carry-Rippler)
+			m.attacks[m.index(sub)] = slide_set(sq, sub, dirs);
+			sub = (sub - m.mask) & m.mask;
+		} while (sub);
+		next += 1ull << popcount(m.mask);
+	}
+}
+
+namespace {
+struct AttackTablesInit {
+	AttackTablesInit() {
+		static const int KOFF[8][2] = {{2,1},{1,2},{-1,2},{-2,1},{-2,-1},{-1,-2},{1,-2},{2,-1}};
+		static const int KINGOFF[8][2] = {{1,1},{1,0},{1,-1},{0,1},{0,-1},{-1,1},{-1,0},{-1,-1}};
+		static const int WPOFF[2][2] = {{1,-1},{1,1}};
+		static const int BPOFF[2][2] = {{-1,-1},{-1,1}};
+		for (int sq=0; sq<64; ++sq) {
+			KNIGHT_ATTACKS[sq] = step_set(sq, KOFF, 8);
+			KING_ATTACKS[sq] = step_set(sq, KINGOFF, 8);
+			PAWN_ATTACKS[0][sq] = step_set(sq, WPOFF, 2);
+			PAWN_ATTACKS[1][sq] = step_set(sq, BPOFF, 2);
+		}
+		init_magics(ROOK_MAGICS, ROOK_TABLE, ROOK_MAGIC_NUMBERS, ROOK_DIRS);
+		init_magics(BISHOP_MAGICS, BISHOP_TABLE, BISHOP_MAGIC_NUMBERS, BISHOP_DIRS);
+		for (int a=0; a<64; ++a) {
+			for (int b=0; b<64; ++b) {
+				BETWEEN_BB[a][b] = LINE_BB[a][b] = 0;
+				if (a == b) continue;
+				uint64_t ab = square_bb(a) | square_bb(b);
+				if (rook_attacks(a, 0) & square_bb(b)) {
+					LINE_BB[a][b] = (rook_attacks(a, 0) & rook_attacks(b, 0)) | ab;
+					BETWEEN_BB[a][b] = rook_attacks(a, square_bb(b)) & rook_attacks(b, square_bb(a));
+				} else if (bishop_attacks(a, 0) & square_bb(b)) {
+					LINE_BB[a][b] = (bishop_attacks(a, 0) & bishop_attacks(b, 0)) | ab;
+					BETWEEN_BB[a][b] = bishop_attacks(a, square_bb(b)) & bishop_attacks(b, square_bb(a));
+				}
+			}
+		}
+	}
+} ATTACK_TABLES_INIT;
+}
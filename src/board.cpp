@@ -1,26 +1,38 @@
 #include "board.hpp"
+#include "stats.hpp"
+#include <cstring>
 
 Zobrist ZOBRIST;
 
 Zobrist::Zobrist() {
+	// Fixed seed: keys must be identical in every run so saved Q-tables keep matching positions.
+	RNG rng(0x5A0B1157C0FFEEull);
 	for (auto &arr : piece_square) {
-		for (auto &v : arr) v = GLOBAL_RNG.u64();
+		for (auto &v : arr) v = rng.u64();
 	}
-	black_to_move = GLOBAL_RNG.u64();
-	for (auto &v : castling) v = GLOBAL_RNG.u64();
-	for (auto &v : ep_file) v = GLOBAL_RNG.u64();
+	black_to_move = rng.u64();
+	for (auto &v : castling) v = rng.u64();
+	for (auto &v : ep_file) v = rng.u64();
 }
 
-static const int PIECE_INDEX[13] = {0,1,2,3,4,5,6,0,7,8,9,10,11};
+static const int PIECE_INDEX[13] = {12,11,10,9,8,7,0,1,2,3,4,5,6}; // by piece+6 -> Zobrist table 1..12
+static const char PIECE_CHARS[] = "kqrbnp.PNBRQK"; // by piece+6
+static const int16_t PIECE_VALUE[13] = {0,-900,-500,-330,-320,-100,0,100,320,330,500,900,0}; // by piece+6, kings count 0
 
 Board::Board() {
 	squares.fill(EMPTY);
+	pieces.fill(0);
+	colors.fill(0);
+	occupied = 0;
+	king_sq.fill(-1);
 	white_to_move = true;
 	castling_rights = 0;
 	ep_square = -1;
 	halfmove_clock = 0;
 	fullmove_number = 1;
 	hash = 0;
+	material = 0;
+	nnue = nullptr;
 }
 
 Board Board::startpos() {
@@ -28,10 +40,10 @@ Board Board::startpos() {
 	const Piece backrank_w[8] = {WR, WN, WB, WQ, WK, WB, WN, WR};
 	const Piece backrank_b[8] = {BR, BN, BB, BQ, BK, BB, BN, BR};
 	for (int f=0; f<8; ++f) {
-		b.squares[idx(0,f)] = backrank_w[f];
-		b.squares[idx(1,f)] = WP;
-		b.squares[idx(6,f)] = BP;
-		b.squares[idx(7,f)] = backrank_b[f];
+		b.put_piece(idx(0,f), backrank_w[f]);
+		b.put_piece(idx(1,f), WP);
+		b.put_piece(idx(6,f), BP);
+		b.put_piece(idx(7,f), backrank_b[f]);
 	}
 	b.white_to_move = true;
 	b.castling_rights = 1|2|4|8;
@@ -42,14 +54,147 @@ Board Board::startpos() {
 	return b;
 }
 
+bool Board::set_fen(const std::string &fen) {
+	Board b;
+	std::istringstream in(fen);
+	std::string placement, stm, castle, ep;
+	if (!(in >> placement >> stm)) return false;
+	int r = 7, f = 0;
+	for (char c : placement) {
+		if (c == '/') {
+			if (f != 8 || r == 0) return false; // every rank spans exactly eight squares
+			--r; f = 0;
+			continue;
+		}
+		if (c >= '1' && c <= '8') {
+			f += c - '0';
+			if (f > 8) return false;
+			continue;
+		}
+		const char *pc = std::strchr(PIECE_CHARS, c);
+		if (!pc || c == '.' || f > 7) return false;
+		b.put_piece(idx(r,f), (Piece)(pc - PIECE_CHARS - 6));
+		++f;
+	}
+	if (r != 0 || f != 8) return false;
+	// positions the move generator and the network cannot handle: one king a side, no pawns
+	// on the back ranks
+	if (popcount(b.bb(WK)) != 1 || popcount(b.bb(BK)) != 1) return false;
+	if ((b.bb(WP) | b.bb(BP)) & 0xFF000000000000FFull) return false;
+	if (stm != "w" && stm != "b") return false;
+	b.white_to_move = stm == "w";
+	if (b.in_check(!b.white_to_move)) return false; // the side that just moved left its king in check
+	// castling, ep and the move counters are optional (EPD omits the counters)
+	if (in >> castle) {
+		for (char c : castle) {
+			if (c == 'K') b.castling_rights |= 1;
+			else if (c == 'Q') b.castling_rights |= 2;
+			else if (c == 'k') b.castling_rights |= 4;
+			else if (c == 'q') b.castling_rights |= 8;
+			else if (c != '-') return false;
+		}
+		// a right whose king or rook is off its home square could never be used legally, and
+		// make_move would castle with an empty rook square
+		if (b.squares[4] != WK) b.castling_rights &= ~3;
+		if (b.squares[7] != WR) b.castling_rights &= ~1;
+		if (b.squares[0] != WR) b.castling_rights &= ~2;
+		if (b.squares[60] != BK) b.castling_rights &= ~12;
+		if (b.squares[63] != BR) b.castling_rights &= ~4;
+		if (b.squares[56] != BR) b.castling_rights &= ~8;
+	}
+	if (in >> ep && ep != "-") {
+		if (ep.size() != 2 || ep[0] < 'a' || ep[0] > 'h' || ep[1] != (b.white_to_move ? '6' : '3')) return false;
+		int sq = idx(ep[1] - '1', ep[0] - 'a');
+		int pawn = b.white_to_move ? sq - 8 : sq + 8; // the pawn that just made the double push
+		int from = b.white_to_move ? sq + 8 : sq - 8;
+		if (b.squares[pawn] != (b.white_to_move ? BP : WP) || b.squares[sq] != EMPTY || b.squares[from] != EMPTY) return false;
+		b.ep_square = (int8_t)sq;
+	}
+	int half, full;
+	if (in >> half) b.halfmove_clock = (uint16_t)half;
+	if (in >> full) b.fullmove_number = (uint16_t)std::max(1, full);
+	b.update_hash();
+	if (nnue) b.attach_nnue(nnue);
+	*this = b;
+	return true;
+}
+
+std::string Board::fen() const {
+	std::string s;
+	for (int r=7; r>=0; --r) {
+		int run = 0;
+		for (int f=0; f<8; ++f) {
+			Piece p = squares[idx(r,f)];
+			if (p == EMPTY) { ++run; continue; }
+			if (run) { s += (char)('0' + run); run = 0; }
+			s += PIECE_CHARS[p + 6];
+		}
+		if (run) s += (char)('0' + run);
+		if (r) s += '/';
+	}
+	s += white_to_move ? " w " : " b ";
+	if (castling_rights & 1) s += 'K';
+	if (castling_rights & 2) s += 'Q';
+	if (castling_rights & 4) s += 'k';
+	if (castling_rights & 8) s += 'q';
+	if (!(castling_rights & 15)) s += '-';
+	s += ' ';
+	if (ep_square < 0) s += '-';
+	else { s += (char)('a' + file_of(ep_square)); s += (char)('1' + rank_of(ep_square)); }
+	s += ' ' + std::to_string(halfmove_clock) + ' ' + std::to_string(fullmove_number);
+	return s;
+}
+
+std::string move_to_uci(const Move &m) {
+	std::string s;
+	s += (char)('a' + file_of(m.from)); s += (char)('1' + rank_of(m.from));
+	s += (char)('a' + file_of(m.to)); s += (char)('1' + rank_of(m.to));
+	if (m.flags & 4) s += PIECE_CHARS[6 - abs_piece((Piece)m.promotion)];
+	return s;
+}
+
+// Board mutation helpers keep the mailbox, bitboards and king squares in sync.
+// Hash updates stay with the caller.
+void Board::put_piece(int sq, Piece p) {
+	uint64_t b = square_bb(sq);
+	int c = is_white(p) ? 0 : 1;
+	squares[sq] = p;
+	pieces[p + 6] |= b;
+	colors[c] |= b;
+	occupied |= b;
+	material += PIECE_VALUE[p + 6];
+	if (abs_piece(p) == 6) king_sq[c] = (int8_t)sq;
+}
+
+void Board::remove_piece(int sq) {
+	Piece p = squares[sq];
+	uint64_t b = square_bb(sq);
+	int c = is_white(p) ? 0 : 1;
+	squares[sq] = EMPTY;
+	pieces[p + 6] &= ~b;
+	colors[c] &= ~b;
+	occupied &= ~b;
+	material -= PIECE_VALUE[p + 6];
+	if (abs_piece(p) == 6) king_sq[c] = -1;
+}
+
+void Board::move_piece(int from, int to) {
+	Piece p = squares[from];
+	uint64_t b = square_bb(from) | square_bb(to);
+	int c = is_white(p) ? 0 : 1;
+	squares[to] = p;
+	squares[from] = EMPTY;
+	pieces[p + 6] ^= b;
+	colors[c] ^= b;
+	occupied ^= b;
+	if (abs_piece(p) == 6) king_sq[c] = (int8_t)to;
+}
+
 void Board::update_hash() {
 	uint64_t h = 0;
-	for (int sq=0; sq<64; ++sq) {
-		Piece p = squares[sq];
-		if (p != EMPTY) {
-			int pi = PIECE_INDEX[p + 6];
-			h ^= ZOBRIST.piece_square[pi][sq];
-		}
+	for (uint64_t occ = occupied; occ; ) {
+		int sq = pop_lsb(occ);
+		h ^= ZOBRIST.piece_square[PIECE_INDEX[squares[sq] + 6]][sq];
 	}
 	if (!white_to_move) h ^= ZOBRIST.black_to_move;
 	h ^= ZOBRIST.castling[castling_rights & 15];
@@ -57,184 +202,183 @@ void Board::update_hash() {
 	hash = h;
 }
 
-static inline bool slide(const Board &b, int sq, int dr, int df, bool by_white) {
-	int r = rank_of(sq), f = file_of(sq);
-	while (true) {
-		r += dr; f += df;
-		if (r < 0 || r >= 8 || f < 0 || f >= 8) return false;
-		int to = idx(r,f);
-		Piece p = b.squares[to];
-		if (!is_empty(p)) {
-			return (by_white && is_white(p)) || (!by_white && is_black(p));
-		}
-	}
+uint64_t Board::attackers_to(int sq, uint64_t occ) const {
+	return (PAWN_ATTACKS[1][sq] & pieces[WP + 6])
+		| (PAWN_ATTACKS[0][sq] & pieces[BP + 6])
+		| (KNIGHT_ATTACKS[sq] & type_bb(2))
+		| (bishop_attacks(sq, occ) & (type_bb(3) | type_bb(5)))
+		| (rook_attacks(sq, occ) & (type_bb(4) | type_bb(5)))
+		| (KING_ATTACKS[sq] & type_bb(6));
 }
 
 bool Board::is_square_attacked(int sq, bool by_white) const {
-	int r = rank_of(sq), f = file_of(sq);
-	// Pawns
-	int pr = by_white ? -1 : 1;
-	for (int df=-1; df<=1; df+=2) {
-		int rr = r + pr, ff = f + df;
-		if (rr>=0 && rr<8 && ff>=0 && ff<8) {
-			Piece p = squares[idx(rr,ff)];
-			if (p == (by_white?WP:BP)) return true;
-		}
-	}
-	// Knights
-	static const int KOFF[8][2]={{2,1},{1,2},{-1,2},{-2,1},{-2,-1},{-1,-2},{1,-2},{2,-1}};
-	for (auto &o:KOFF){int rr=r+o[0], ff=f+o[1]; if(rr>=0&&rr<8&&ff>=0&&ff<8){Piece p=squares[idx(rr,ff)]; if(p==(by_white?WN:BN)) return true;}}
-	// Diagonals (bishops/queens)
-	for (auto dir : std::array<std::pair<int,int>,4>{{std::make_pair(1,1),{1,-1},{-1,1},{-1,-1}}}) {
-		int rr=r+dir.first, ff=f+dir.second;
-		while (rr>=0&&rr<8&&ff>=0&&ff<8) {
-			Piece p = squares[idx(rr,ff)];
-			if (!is_empty(p)) {
-				if (is_white(p)==by_white && (abs_piece(p)==3 || abs_piece(p)==5)) return true;
-				break;
-			}
-			r+=dir.first; ff+=dir.second;
-		}
-	}
-	// Orthogonals (rooks/queens)
-	for (auto dir : std::array<std::pair<int,int>,4>{{std::make_pair(1,0),{-1,0},{0,1},{0,-1}}}) {
-		int rr=r+dir.first, ff=f+dir.second;
-		while (rr>=0&&rr<8&&ff>=0&&ff<8) {
-			Piece p = squares[idx(rr,ff)];
-			if (!is_empty(p)) {
-				if (is_white(p)==by_white && (abs_piece(p)==4 || abs_piece(p)==5)) return true;
-				break;
-			}
-			r+=dir.first; ff+=dir.second;
-		}
-	}
-	// Kings
-	for (int dr=-1; dr<=1; ++dr) for (int df=-1; df<=1; ++df) if (dr||df) {
-		int rr=r+dr, ff=f+df; if(rr>=0&&rr<8&&ff>=0&&ff<8){Piece p=squares[idx(rr,ff)]; if(p==(by_white?WK:BK)) return true;}
-	}
+	const int c = by_white ? 0 : 1;
+	const int s = by_white ? 1 : -1; // sign of attacker piece codes
+	// a pawn of colour c attacks sq iff a pawn of the other colour on sq would attack it back
+	if (PAWN_ATTACKS[c ^ 1][sq] & pieces[6 + s]) return true;
+	if (KNIGHT_ATTACKS[sq] & pieces[6 + 2*s]) return true;
+	if (KING_ATTACKS[sq] & pieces[6 + 6*s]) return true;
+	const uint64_t queens = pieces[6 + 5*s];
+	if (bishop_attacks(sq, occupied) & (pieces[6 + 3*s] | queens)) return true;
+	if (rook_attacks(sq, occupied) & (pieces[6 + 4*s] | queens)) return true;
 	return false;
 }
 
-bool Board::in_check(bool for_white) const {
-	int king_sq = -1; Piece k = for_white?WK:BK;
-	for (int i=0;i<64;++i) if (squares[i]==k){ king_sq=i; break; }
-	if (king_sq<0) return false; // shouldn't happen
-	return is_square_attacked(king_sq, !for_white);
+int Board::see(const Move &m) const {
+	static const int VALUE[7] = {0,100,320,330,500,900,20000}; // by piece type
+	const int to = m.to;
+	const Piece mover = squares[m.from];
+	uint64_t occ = occupied ^ square_bb(m.from);
+	int gain[32], d = 0;
+	gain[0] = (m.flags & 2) ? VALUE[1] : VALUE[abs_piece(squares[to])];
+	if (m.flags & 2) occ ^= square_bb(to + (is_white(mover) ? -8 : 8));
+	int on_sq = abs_piece(mover); // piece now standing on to, next to be captured
+	if (m.flags & 4) { on_sq = m.promotion < 0 ? -m.promotion : m.promotion; gain[0] += VALUE[on_sq] - VALUE[1]; }
+	const uint64_t diag = type_bb(3) | type_bb(5), orth = type_bb(4) | type_bb(5);
+	uint64_t attackers = attackers_to(to, occ) & occ;
+	bool white = !is_white(mover);
+	while (d < 31) {
+		uint64_t mine = attackers & colors[white ? 0 : 1];
+		if (!mine) break;
+		int t = 1;
+		uint64_t from_bb = 0;
+		for (; t <= 6; ++t) if ((from_bb = mine & pieces[6 + (white ? t : -t)])) break;
+		from_bb &= 0 - from_bb; // least valuable attacker, lowest square
+		// a king may only recapture if the other side has nothing left to take it
+		if (t == 6 && (attackers & ~from_bb & colors[white ? 1 : 0])) break;
+		++d;
+		gain[d] = VALUE[on_sq] - gain[d-1];
+		if (std::max(-gain[d-1], gain[d]) < 0) { --d; break; } // this capture cannot change the outcome
+		on_sq = t;
+		occ ^= from_bb;
+		attackers |= (bishop_attacks(to, occ) & diag) | (rook_attacks(to, occ) & orth); // uncovered x-rays
+		attackers &= occ;
+		white = !white;
+	}
+	while (d > 0) { gain[d-1] = -std::max(-gain[d-1], gain[d]); --d; }
+	return gain[0];
 }
 
-static void add_if_legal(const Board &b, std::vector<Move> &moves, int from, int to, int promo=0, uint8_t flags=0) {
-	Board c = b;
-	Piece cap; uint8_t oc; int8_t oe; uint16_t oh;
-	Move m{(uint8_t)from,(uint8_t)to,(int8_t)promo,flags};
-	c.make_move(m, cap, oc, oe, oh);
-	bool illegal = c.in_check(!c.white_to_move);
-	c.unmake_move(m, cap, oc, oe, oh);
-	if (!illegal) moves.push_back(m);
+bool Board::in_check(bool for_white) const {
+	int king_sq_ = king_sq[for_white ? 0 : 1];
+	if (king_sq_<0) return false; // shouldn't happen
+	return is_square_attacked(king_sq_, !for_white);
 }
 
-std::vector<Move> Board::generate_legal_moves() const {
-	std::vector<Move> moves;
-	moves.reserve(64);
-	for (int sq=0; sq<64; ++sq) {
-		Piece p = squares[sq]; if (p==EMPTY) continue; if (white_to_move != is_white(p)) continue;
-		int r=rank_of(sq), f=file_of(sq);
-		switch (abs_piece(p)) {
-			case 1: { // Pawn
-				int dir = is_white(p) ? 1 : -1;
-				int start_rank = is_white(p) ? 1 : 6;
-				int promo_rank = is_white(p) ? 6 : 1;
-				int rr = r + dir;
-				if (rr>=0 && rr<8) {
-					int to = idx(rr,f);
-					if (is_empty(squares[to])) {
-						if (r==promo_rank) {
-							for (int pr : {4,5,2,3}) { // R,Q,N,B in code index terms later converted
-								int pp = is_white(p) ? pr : -pr;
-								add_if_legal(*this,moves,sq,to,pp,4);
-							}
-						} else {
-							add_if_legal(*this,moves,sq,to);
-							if (r==start_rank) {
-								int to2 = idx(r+2*dir, f);
-								if (is_empty(squares[to2])) add_if_legal(*this,moves,sq,to2);
-							}
-						}
-					}
-					// captures
-					for (int df=-1; df<=1; df+=2) {
-						int ff=f+df; if(ff<0||ff>=8) continue; int to2=idx(rr,ff); if(rr<0||rr>=8) continue;
-						if (!is_empty(squares[to2]) && (is_white(p)!=is_white(squares[to2]))) {
-							if (r==promo_rank) {
-								for (int pr : {4,5,2,3}) { int pp = is_white(p)?pr:-pr; add_if_legal(*this,moves,sq,to2,pp,4);} 
-							} else add_if_legal(*this,moves,sq,to2);
-						}
-						// en-passant
-						if (ep_square>=0 && to2==ep_square) {
-							add_if_legal(*this,moves,sq,to2,0,2);
-						}
-					}
-				}
-				}
-				break;
-			case 2: { // Knight
-				static const int KOFF[8][2]={{2,1},{1,2},{-1,2},{-2,1},{-2,-1},{-1,-2},{1,-2},{2,-1}};
-				for (auto &o:KOFF){int rr=r+o[0], ff=f+o[1]; if(rr>=0&&rr<8&&ff>=0&&ff<8){int to=idx(rr,ff); Piece q=squares[to]; if(is_empty(q)||is_white(q)!=is_white(p)) add_if_legal(*this,moves,sq,to);}}
+// Fully legal generation: checkers, pins and the check-evasion mask are computed once per
+// position, so only king moves and en-passant need an attack probe.
+void Board::generate_legal_moves(MoveList &moves) const {
+	STAT_TIMER(TM_MOVEGEN);
+	moves.clear();
+	const bool white = white_to_move;
+	const int us = white ? 0 : 1;
+	const int s = white ? 1 : -1;
+	const uint64_t own = colors[us], enemy = colors[us ^ 1];
+	const int ksq = king_sq[us];
+	if (ksq < 0) return;
+	auto add = [&](int from, int to, int promo=0, uint8_t flags=0) {
+		moves.push_back(Move{(uint8_t)from,(uint8_t)to,(int8_t)promo,flags});
+	};
+	auto add_promotions = [&](int from, int to) {
+		for (int pr : {4,5,2,3}) add(from,to,pr*s,4); // R,Q,N,B
+	};
+	const uint64_t their_diag = pieces[6 - 3*s] | pieces[6 - 5*s];
+	const uint64_t their_orth = pieces[6 - 4*s] | pieces[6 - 5*s];
+	const uint64_t checkers = attackers_to(ksq, occupied) & enemy;
+
+	// King
+	const uint64_t occ_wo_king = occupied ^ square_bb(ksq);
+	for (uint64_t att = KING_ATTACKS[ksq] & ~own; att; ) {
+		int to = pop_lsb(att);
+		if (!(attackers_to(to, occ_wo_king) & enemy)) add(ksq,to);
+	}
+	if (more_than_one(checkers)) return; // double check: only the king may move
+
+	// Castling (the king's own square is already known to be safe)
+	if (!checkers) {
+		if (white) {
+			// King side
+			if ((castling_rights & 1) && !(occupied & (square_bb(idx(0,5)) | square_bb(idx(0,6)))) && !is_square_attacked(idx(0,5), false) && !is_square_attacked(idx(0,6), false)) {
+				add(ksq,idx(0,6),0,1);
 			}
-			break;
-			case 3: { // Bishop
-				for (int dr : {1,-1}) for (int df : {1,-1}) {
-					int rr=r+dr, ff=f+df; while(rr>=0&&rr<8&&ff>=0&&ff<8){int to=idx(rr,ff); Piece q=squares[to]; if(is_empty(q)) {add_if_legal(*this,moves,sq,to);} else { if(is_white(q)!=is_white(p)) add_if_legal(*this,moves,sq,to); break;} rr+=dr; ff+=df;}
-				}
+			// Queen side
+			if ((castling_rights & 2) && !(occupied & (square_bb(idx(0,1)) | square_bb(idx(0,2)) | square_bb(idx(0,3)))) && !is_square_attacked(idx(0,2), false) && !is_square_attacked(idx(0,3), false)) {
+				add(ksq,idx(0,2),0,1);
 			}
-			break;
-			case 4: { // Rook
-				for (auto [dr,df] : std::array<std::pair<int,int>,4>{{{1,0},{-1,0},{0,1},{0,-1}}}) {
-					int rr=r+dr, ff=f+df; while(rr>=0&&rr<8&&ff>=0&&ff<8){int to=idx(rr,ff); Piece q=squares[to]; if(is_empty(q)) {add_if_legal(*this,moves,sq,to);} else { if(is_white(q)!=is_white(p)) add_if_legal(*this,moves,sq,to); break;} rr+=dr; ff+=df;}
-				}
+		} else {
+			if ((castling_rights & 4) && !(occupied & (square_bb(idx(7,5)) | square_bb(idx(7,6)))) && !is_square_attacked(idx(7,5), true) && !is_square_attacked(idx(7,6), true)) {
+				add(ksq,idx(7,6),0,1);
 			}
-			break;
-			case 5: { // Queen
-				for (auto [dr,df] : std::array<std::pair<int,int>,8>{{{1,0},{-1,0},{0,1},{0,-1},{1,1},{1,-1},{-1,1},{-1,-1}}}) {
-					int rr=r+dr, ff=f+df; while(rr>=0&&rr<8&&ff>=0&&ff<8){int to=idx(rr,ff); Piece q=squares[to]; if(is_empty(q)) {add_if_legal(*this,moves,sq,to);} else { if(is_white(q)!=is_white(p)) add_if_legal(*this,moves,sq,to); break;} rr+=dr; ff+=df;}
-				}
+			if ((castling_rights & 8) && !(occupied & (square_bb(idx(7,1)) | square_bb(idx(7,2)) | square_bb(idx(7,3)))) && !is_square_attacked(idx(7,2), true) && !is_square_attacked(idx(7,3), true)) {
+				add(ksq,idx(7,2),0,1);
 			}
-			break;
-			case 6: { // King
-				for (int dr=-1; dr<=1; ++dr) for (int df=-1; df<=1; ++df) if (dr||df){int rr=r+dr, ff=f+df; if(rr>=0&&rr<8&&ff>=0&&ff<8){int to=idx(rr,ff); Piece q=squares[to]; if(is_empty(q)||is_white(q)!=is_white(p)) add_if_legal(*this,moves,sq,to);}}
-				// Castling
-				if (!in_check(is_white(p))) {
-					if (is_white(p)) {
-						// King side
-						if ((castling_rights & 1) && is_empty(squares[idx(0,5)]) && is_empty(squares[idx(0,6)]) && !is_square_attacked(idx(0,5), false) && !is_square_attacked(idx(0,6), false)) {
-							add_if_legal(*this,moves,sq,idx(0,6),0,1);
-						}
-						// Queen side
-						if ((castling_rights & 2) && is_empty(squares[idx(0,1)]) && is_empty(squares[idx(0,2)]) && is_empty(squares[idx(0,3)]) && !is_square_attacked(idx(0,2), false) && !is_square_attacked(idx(0,3), false)) {
-							add_if_legal(*this,moves,sq,idx(0,2),0,1);
-						}
-					} else {
-						if ((castling_rights & 4) && is_empty(squares[idx(7,5)]) && is_empty(squares[idx(7,6)]) && !is_square_attacked(idx(7,5), true) && !is_square_attacked(idx(7,6), true)) {
-							add_if_legal(*this,moves,sq,idx(7,6),0,1);
-						}
-						if ((castling_rights & 8) && is_empty(squares[idx(7,1)]) && is_empty(squares[idx(7,2)]) && is_empty(squares[idx(7,3)]) && !is_square_attacked(idx(7,2), true) && !is_square_attacked(idx(7,3), true)) {
-							add_if_legal(*this,moves,sq,idx(7,2),0,1);
-						}
-					}
-				}
+		}
+	}
+
+	// Evasion mask: with a single checker, other pieces must capture it or block the ray
+	const uint64_t target = checkers ? (BETWEEN_BB[ksq][lsb(checkers)] | checkers) : ~0ull;
+	// Pinned pieces: own pieces that are the only blocker between the king and an enemy slider
+	uint64_t pinned = 0;
+	for (uint64_t snipers = (rook_attacks(ksq, 0) & their_orth) | (bishop_attacks(ksq, 0) & their_diag); snipers; ) {
+		uint64_t blockers = BETWEEN_BB[ksq][pop_lsb(snipers)] & occupied;
+		if (blockers && !more_than_one(blockers) && (blockers & own)) pinned |= blockers;
+	}
+	auto allowed = [&](int from) {
+		return (pinned & square_bb(from)) ? target & LINE_BB[ksq][from] : target;
+	};
+
+	// Pawns
+	const int dir = white ? 8 : -8;
+	const uint64_t start_rank = white ? RANK_1_BB << 8 : RANK_1_BB << 48;
+	const uint64_t promo_rank = white ? RANK_1_BB << 48 : RANK_1_BB << 8;
+	for (uint64_t pawns = pieces[6 + s]; pawns; ) {
+		int sq = pop_lsb(pawns);
+		const uint64_t ok = allowed(sq);
+		bool promo = (square_bb(sq) & promo_rank) != 0;
+		int to = sq + dir;
+		if (!(occupied & square_bb(to))) {
+			if (ok & square_bb(to)) {
+				if (promo) add_promotions(sq, to); else add(sq,to);
 			}
-			break;
+			if ((square_bb(sq) & start_rank) && !(occupied & square_bb(to + dir)) && (ok & square_bb(to + dir))) add(sq,to + dir);
+		}
+		for (uint64_t caps = PAWN_ATTACKS[us][sq] & enemy & ok; caps; ) {
+			int to2 = pop_lsb(caps);
+			if (promo) add_promotions(sq, to2); else add(sq,to2);
+		}
+		// en-passant: removes two pieces from one line, so probe the resulting occupancy
+		if (ep_square >= 0 && (PAWN_ATTACKS[us][sq] & square_bb(ep_square))) {
+			int cap_sq = ep_square - dir;
+			uint64_t occ = (occupied ^ square_bb(sq) ^ square_bb(cap_sq)) | square_bb(ep_square);
+			bool legal = !(checkers & ~square_bb(cap_sq))
+				&& !(rook_attacks(ksq, occ) & their_orth)
+				&& !(bishop_attacks(ksq, occ) & their_diag);
+			if (legal) add(sq,ep_square,0,2);
 		}
 	}
-	return moves;
+	// Knights (a pinned knight can never move), bishops, rooks, queens
+	for (int t=2; t<=5; ++t) {
+		for (uint64_t pcs = pieces[6 + t*s]; pcs; ) {
+			int sq = pop_lsb(pcs);
+			uint64_t att = t==2 ? KNIGHT_ATTACKS[sq] : t==3 ? bishop_attacks(sq, occupied) : t==4 ? rook_attacks(sq, occupied) : queen_attacks(sq, occupied);
+			for (att &= ~own & allowed(sq); att; ) add(sq,pop_lsb(att));
+		}
+	}
+}
+
+std::vector<Move> Board::generate_legal_moves() const {
+	MoveList moves;
+	generate_legal_moves(moves);
+	return std::vector<Move>(moves.begin(), moves.end());
 }
 
-void Board::make_move(const Move &m, Piece &captured_out, uint8_t &old_castle, int8_t &old_ep, uint16_t &old_half) {
-	old_castle = castling_rights;
-	old_ep = ep_square;
-	old_half = halfmove_clock;
+void Board::make_move(const Move &m) {
+	STAT_TIMER(TM_MAKE);
+	if (nnue) nnue_push(m);
+	states.push_back(StateInfo{hash, m, EMPTY, castling_rights, ep_square, halfmove_clock, material, king_sq});
 	Piece moving = squares[m.from];
 	Piece captured = squares[m.to];
-	captured_out = captured;
+	Piece captured_out = captured;
 	// hash out
 	if (moving != EMPTY) hash ^= ZOBRIST.piece_square[PIECE_INDEX[moving+6]][m.from];
 	if (captured != EMPTY) hash ^= ZOBRIST.piece_square[PIECE_INDEX[captured+6]][m.to];
@@ -244,8 +388,8 @@ void Board::make_move(const Move &m, Piece &captured_out, uint8_t &old_castle, i
 
 	ep_square = -1;
 	// move piece
-	squares[m.to] = squares[m.from];
-	squares[m.from] = EMPTY;
+	if (captured != EMPTY) remove_piece(m.to);
+	move_piece(m.from, m.to);
 	// special moves
 	if (m.flags & 2) { // en-passant capture
 		int dir = is_white(moving) ? -1 : 1;
@@ -253,7 +397,7 @@ void Board::make_move(const Move &m, Piece &captured_out, uint8_t &old_castle, i
 		captured_out = squares[cap_sq];
 		if (captured_out != EMPTY) {
 			hash ^= ZOBRIST.piece_square[PIECE_INDEX[captured_out+6]][cap_sq];
-			squares[cap_sq] = EMPTY;
+			remove_piece(cap_sq);
 		}
 	}
 	if (abs_piece(moving)==6 && (m.flags & 1)) { // castle
@@ -261,14 +405,14 @@ void Board::make_move(const Move &m, Piece &captured_out, uint8_t &old_castle, i
 			int r = is_white(moving)?0:7;
 			int rook_from = idx(r,7), rook_to = idx(r,5);
 			Piece rook = squares[rook_from];
-			squares[rook_to] = rook; squares[rook_from] = EMPTY;
+			move_piece(rook_from, rook_to);
 			hash ^= ZOBRIST.piece_square[PIECE_INDEX[rook+6]][rook_from];
 			hash ^= ZOBRIST.piece_square[PIECE_INDEX[rook+6]][rook_to];
 		} else if (file_of(m.to)==2) {
 			int r = is_white(moving)?0:7;
 			int rook_from = idx(r,0), rook_to = idx(r,3);
 			Piece rook = squares[rook_from];
-			squares[rook_to] = rook; squares[rook_from] = EMPTY;
+			move_piece(rook_from, rook_to);
 			hash ^= ZOBRIST.piece_square[PIECE_INDEX[rook+6]][rook_from];
 			hash ^= ZOBRIST.piece_square[PIECE_INDEX[rook+6]][rook_to];
 		}
@@ -276,7 +420,8 @@ void Board::make_move(const Move &m, Piece &captured_out, uint8_t &old_castle, i
 	// promotions
 	if (m.flags & 4) {
 		Piece promoted = (Piece)m.promotion;
-		squares[m.to] = promoted;
+		remove_piece(m.to);
+		put_piece(m.to, promoted);
 	}
 	// update castling rights if king/rook moved or rook captured
 	if (moving==WK) castling_rights &= ~(1|2);
@@ -290,6 +435,7 @@ void Board::make_move(const Move &m, Piece &captured_out, uint8_t &old_castle, i
 		int mid = idx((rank_of(m.to)+rank_of(m.from))/2, file_of(m.to));
 		ep_square = mid;
 	}
+	states.back().captured = captured_out;
 	// halfmove clock
 	if (abs_piece(moving)==1 || captured_out!=EMPTY) halfmove_clock = 0; else ++halfmove_clock;
 	if (!white_to_move) ++fullmove_number;
@@ -303,62 +449,76 @@ void Board::make_move(const Move &m, Piece &captured_out, uint8_t &old_castle, i
 	hash ^= ZOBRIST.black_to_move;
 }
 
-void Board::unmake_move(const Move &m, Piece captured, uint8_t old_castle, int8_t old_ep, uint16_t old_half) {
-	// Recompute fully for safety and simplicity
-	// (This is less efficient but still fine for MCTS here.)
-	// We'll snapshot the board before move via make_move caller data.
-	// To simplify, we revert naively by reconstructing from scratch is expensive.
-	// Instead, perform inverse of make with stored data.
+void Board::unmake_move() {
+	STAT_TIMER(TM_UNMAKE);
+	if (nnue) nnue_acc.pop_back();
+	// Pieces are moved back by hand; everything else is restored from the saved state.
+	const StateInfo st = states.back();
+	states.pop_back();
+	const Move &m = st.move;
+	const Piece captured = st.captured;
 	white_to_move = !white_to_move;
 	Piece moving = squares[m.to];
 	// handle promotion
 	if (m.flags & 4) {
 		moving = (is_white(moving)?WP:BP);
+		remove_piece(m.to);
+		put_piece(m.to, moving);
 	}
 	// move back
-	squares[m.from] = moving;
-	squares[m.to] = captured;
+	move_piece(m.to, m.from);
+	if (captured != EMPTY && !(m.flags & 2)) put_piece(m.to, captured);
 	// en-passant restoration
 	if (m.flags & 2) {
-		int dir = white_to_move ? 1 : -1; // because we toggled
+		int dir = white_to_move ? -1 : 1; // captured pawn sits behind the mover's target square
 		int cap_sq = idx(rank_of(m.to)+dir, file_of(m.to));
-		squares[cap_sq] = white_to_move ? BP : WP;
-		squares[m.to] = EMPTY;
+		put_piece(cap_sq, white_to_move ? BP : WP);
 	}
 	// castle undo
 	if ((abs_piece(moving)==6) && (m.flags & 1)) {
 		if (file_of(m.to)==6) {
 			int r = white_to_move?0:7; int rook_from = idx(r,7), rook_to = idx(r,5);
-			Piece rook = squares[rook_to]; squares[rook_from]=rook; squares[rook_to]=EMPTY;
+			move_piece(rook_to, rook_from);
 		} else if (file_of(m.to)==2) {
 			int r = white_to_move?0:7; int rook_from = idx(r,0), rook_to = idx(r,3);
-			Piece rook = squares[rook_to]; squares[rook_from]=rook; squares[rook_to]=EMPTY;
+			move_piece(rook_to, rook_from);
 		}
 	}
-	castling_rights = old_castle;
-	ep_square = old_ep;
-	halfmove_clock = old_half;
+	castling_rights = st.castling_rights;
+	ep_square = st.ep_square;
+	halfmove_clock = st.halfmove_clock;
+	material = st.material;
+	king_sq = st.king_sq;
+	hash = st.hash;
 	if (white_to_move) --fullmove_number;
-	update_hash();
 }
 
-GameResult Board::evaluate_terminal() const {
-	auto moves = generate_legal_moves();
-	if (!moves.empty()) return {0.0f,false};
-	if (in_check(white_to_move)) {
-		return {white_to_move ? -1.0f : 1.0f, true};
+bool Board::is_repetition(int times) const {
+	const size_t n = states.size();
+	const size_t window = std::min<size_t>(halfmove_clock, n); // nothing before the last irreversible move can repeat
+	for (size_t i=2; i<=window; i+=2) {
+		if (states[n - i].hash == hash && --times == 0) return true;
 	}
-	if (halfmove_clock >= 100) return {0.0f,true};
-	return {0.0f,true}; // stalemate
+	return false;
+}
+
+bool Board::insufficient_material() const {
+	if (type_bb(1) | type_bb(4) | type_bb(5)) return false;
+	const uint64_t minors = type_bb(2) | type_bb(3);
+	if (!more_than_one(minors)) return true;
+	// only bishops, all on one square colour
+	const uint64_t DARK = 0xAA55AA55AA55AA55ull;
+	return !type_bb(2) && (!(minors & DARK) || !(minors & ~DARK));
 }
 
-int Board::material_eval() const {
-	static const int val[7] = {0,100,320,330,500,900,0};
-	int s = 0;
-	for (auto p : squares) {
-		int a = abs_piece(p);
-		if (a==6) continue;
-		s += (is_white(p)?1:-1) * val[a];
+GameResult Board::evaluate_terminal() const {
+	STAT_TIMER(TM_TERMINAL);
+	MoveList moves;
+	generate_legal_moves(moves);
+	if (moves.empty()) {
+		if (in_check(white_to_move)) return {white_to_move ? -1.0f : 1.0f, true};
+		return {0.0f,true}; // stalemate
 	}
-	return s;
-}
\ No newline at end of file
+	if (halfmove_clock >= 100 || is_repetition(2) || insufficient_material()) return {0.0f,true};
+	return {0.0f,false};
+}
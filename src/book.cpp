@@ -0,0 +1,157 @@
+#include "book.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char BOOK_MAGIC[8] = {'C','R','L','B','O','O','K','\0'};
+
+bool Book::open(const std::string &path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BookFileHeader)) { ::close(fd); return false; }
+	void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd); // the mapping keeps the file alive
+	if (p == MAP_FAILED) return false;
+	const BookFileHeader *h = (const BookFileHeader*)p;
+	bool ok = std::memcmp(h->magic, BOOK_MAGIC, 8) == 0 && h->version == BOOK_VERSION && h->entry_size == sizeof(BookEntry)
+		&& (uint64_t)st.st_size == sizeof(BookFileHeader) + h->count * sizeof(BookEntry);
+	if (!ok) { munmap(p, (size_t)st.st_size); return false; }
+	map = p;
+	map_len = (size_t)st.st_size;
+	entries = (const BookEntry*)(h + 1);
+	count = h->count;
+	return true;
+}
+
+void Book::close() {
+	if (map) munmap(map, map_len);
+	map = nullptr; map_len = 0; entries = nullptr; count = 0;
+}
+
+void Book::moves(const Board &b, std::vector<std::pair<Move,uint32_t>> &out) const {
+	out.clear();
+	if (!count) return;
+	const BookEntry *end = entries + count;
+	const BookEntry *it = std::lower_bound(entries, end, b.hash, [](const BookEntry &e, uint64_t h) { return e.hash < h; });
+	if (it == end || it->hash != b.hash) return;
+	MoveList legal;
+	b.generate_legal_moves(legal);
+	for (; it != end && it->hash == b.hash; ++it) {
+		// a move that is not legal here means the hash collided with another position
+		const Move *m = std::find_if(legal.begin(), legal.end(), [&](const Move &l) { return pack_move(l) == it->move; });
+		if (m == legal.end()) { out.clear(); return; }
+		out.emplace_back(*m, it->weight);
+	}
+}
+
+bool Book::pick(const Board &b, const BookOptions &opt, Move &out) const {
+	std::vector<std::pair<Move,uint32_t>> mv;
+	moves(b, mv);
+	if (mv.empty()) return false;
+	uint64_t total = 0;
+	for (auto &m : mv) total += m.second;
+	if (total < opt.min_visits || mv[0].second < opt.min_share * (double)total) return false;
+	out = mv[0].first;
+	return true;
+}
+
+uint64_t BookBuilder::add_records(TrainReader &r) {
+	TrainSample s;
+	uint64_t n = 0;
+	while (r.next(s)) {
+		auto &moves = recorded[s.board.hash];
+		for (auto &v : s.visits) {
+			uint16_t code = pack_move(v.first);
+			auto it = std::find_if(moves.begin(), moves.end(), [&](const std::pair<uint16_t,uint32_t> &m) { return m.first == code; });
+			if (it == moves.end()) moves.emplace_back(code, v.second);
+			else it->second = (uint32_t)std::min<uint64_t>(UINT32_MAX, (uint64_t)it->second + v.second);
+		}
+		++n;
+	}
+	return n;
+}
+
+// Appends b's book moves to out, if it has enough weight, and returns them.
+std::vector<Move> BookBuilder::add_position(Board &b, std::vector<BookEntry> &out) {
+	MoveList legal;
+	b.generate_legal_moves(legal);
+	auto rec = recorded.find(b.hash);
+	std::vector<std::pair<Move,uint32_t>> weighted;
+	uint64_t total = 0;
+	for (const Move &m : legal) {
+		uint64_t w = 0;
+		if (!qfiles.empty()) {
+			b.make_move(m);
+			for (const QFile *q : qfiles) {
+				const QRecord *r = q->probe(b.hash);
+				if (r) w += r->visits;
+			}
+			b.unmake_move();
+		}
+		if (rec != recorded.end()) {
+			uint16_t code = pack_move(m);
+			for (auto &v : rec->second) if (v.first == code) w += v.second;
+		}
+		if (!w) continue;
+		w = std::min<uint64_t>(w, UINT32_MAX);
+		weighted.emplace_back(m, (uint32_t)w);
+		total += w;
+	}
+	std::vector<Move> kept;
+	if (total < opt.min_visits) return kept;
+	std::stable_sort(weighted.begin(), weighted.end(), [](const std::pair<Move,uint32_t> &x, const std::pair<Move,uint32_t> &y) { return x.second > y.second; });
+	if (weighted.size() > (size_t)opt.max_moves) weighted.resize((size_t)opt.max_moves);
+	for (auto &w : weighted) {
+		out.push_back(BookEntry{b.hash, pack_move(w.first), w.second});
+		kept.push_back(w.first);
+	}
+	return kept;
+}
+
+bool BookBuilder::write(const std::string &path, uint64_t &positions, uint64_t &entries) {
+	std::vector<BookEntry> out;
+	// breadth first, so a transposition is taken at the lowest ply it is reached
+	std::deque<std::pair<Board,int>> queue;
+	std::unordered_set<uint64_t> seen;
+	queue.emplace_back(Board::startpos(), 0);
+	seen.insert(queue.front().first.hash);
+	while (!queue.empty()) {
+		Board b = std::move(queue.front().first);
+		int ply = queue.front().second;
+		queue.pop_front();
+		for (const Move &m : add_position(b, out)) {
+			if (ply + 1 >= opt.max_plies) break;
+			b.make_move(m);
+			if (seen.insert(b.hash).second) queue.emplace_back(b, ply + 1);
+			b.unmake_move();
+		}
+	}
+	// stable: the walk emitted each position's moves by falling weight
+	std::stable_sort(out.begin(), out.end(), [](const BookEntry &x, const BookEntry &y) { return x.hash < y.hash; });
+	entries = out.size();
+	positions = 0;
+	for (size_t i=0; i<out.size(); ++i) if (i == 0 || out[i].hash != out[i-1].hash) ++positions;
+
+	BookFileHeader h;
+	std::memcpy(h.magic, BOOK_MAGIC, 8);
+	h.version = BOOK_VERSION;
+	h.entry_size = sizeof(BookEntry);
+	h.count = out.size();
+	std::string tmp = path + ".tmp." + std::to_string(getpid());
+	FILE *f = std::fopen(tmp.c_str(), "wb");
+	if (!f) return false;
+	bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 && std::fwrite(out.data(), sizeof(BookEntry), out.size(), f) == out.size();
+	ok = std::fflush(f) == 0 && ok;
+	ok = fsync(fileno(f)) == 0 && ok;
+	ok = std::fclose(f) == 0 && ok;
+	if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) { std::remove(tmp.c_str()); return false; }
+	return true;
+}
@@ -1,4 +1,20 @@
 #include "common.hpp"
+#include <ctime>
 
-RNG GLOBAL_RNG;
+static std::atomic<uint64_t> &rng_base() {
+	static std::atomic<uint64_t> base{((uint64_t)std::random_device{}() << 32) ^ std::random_device{}() ^ (uint64_t)time(nullptr)};
+	return base;
+}
+static std::atomic<uint64_t> rng_streams{0};
 
+uint64_t next_rng_seed() {
+	return rng_base().load(std::memory_order_relaxed) + 0xD1B54A32D192ED03ull * ++rng_streams;
+}
+
+void seed_rngs(uint64_t seed) {
+	rng_base().store(seed, std::memory_order_relaxed);
+	rng_streams = 0;
+	GLOBAL_RNG.seed(next_rng_seed());
+}
+
+thread_local RNG GLOBAL_RNG;
@@ -0,0 +1,316 @@
+#include "egtb.hpp"
+#include "bitboard.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char EGTB_MAGIC[8] = {'C','R','L','E','G','T','B','\0'};
+
+// Strong side's pieces besides its king, per table.
+static const int TB_PIECES[TB_TABLES][2] = {{4, 0}, {5, 0}, {3, 2}, {1, 0}};
+static const int TB_NPIECES[TB_TABLES] = {1, 1, 2, 1};
+static const char *TB_NAMES[TB_TABLES] = {"KRK", "KQK", "KBNK", "KPK"};
+static const uint64_t TB_ENTRIES[TB_TABLES] = {10 * 64 * 64 * 2, 10 * 64 * 64 * 2, 10 * 64 * 64 * 64 * 2, 24 * 64 * 64 * 2};
+
+enum : uint8_t { TB_DRAW, TB_WIN, TB_LOSS, TB_INVALID }; // for the side to move; invalid only while building
+
+namespace {
+
+// a1-d1-d4 triangle, the strong king's squares in pawnless tables
+const int TRIANGLE_SQ[10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+const int TRIANGLE_INDEX[64] = {
+	0, 1, 2, 3, -1, -1, -1, -1,
+	-1, 4, 5, 6, -1, -1, -1, -1,
+	-1, -1, 7, 8, -1, -1, -1, -1,
+	-1, -1, -1, 9, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+struct TbPos {
+	int sk, wk; // strong and weak king
+	int p[2]; // strong pieces in TB_PIECES order
+	bool strong_to_move;
+};
+
+int transpose(int sq) { return ((sq & 7) << 3) | (sq >> 3); }
+
+// Index of pos in table t after folding it by the table's symmetries.
+uint64_t tb_index(int t, TbPos pos) {
+	const int n = TB_NPIECES[t];
+	if (t == TB_KPK) {
+		if ((pos.p[0] & 7) > 3) { pos.sk ^= 7; pos.wk ^= 7; pos.p[0] ^= 7; }
+		uint64_t pawn = (uint64_t)(((pos.p[0] >> 3) - 1) * 4 + (pos.p[0] & 7));
+		return ((pawn * 64 + pos.sk) * 64 + pos.wk) * 2 + (pos.strong_to_move ? 0 : 1);
+	}
+	int flip = ((pos.sk & 7) > 3 ? 7 : 0) | ((pos.sk >> 3) > 3 ? 56 : 0);
+	pos.sk ^= flip; pos.wk ^= flip;
+	for (int i=0; i<n; ++i) pos.p[i] ^= flip;
+	// below the a1-h8 diagonal; with the king on it, the first piece off it decides
+	int d = (pos.sk >> 3) - (pos.sk & 7);
+	if (!d) d = (pos.wk >> 3) - (pos.wk & 7);
+	for (int i=0; i<n && !d; ++i) d = (pos.p[i] >> 3) - (pos.p[i] & 7);
+	if (d > 0) {
+		pos.sk = transpose(pos.sk); pos.wk = transpose(pos.wk);
+		for (int i=0; i<n; ++i) pos.p[i] = transpose(pos.p[i]);
+	}
+	uint64_t idx = (uint64_t)TRIANGLE_INDEX[pos.sk] * 64 + pos.wk;
+	for (int i=0; i<n; ++i) idx = idx * 64 + pos.p[i];
+	return idx * 2 + (pos.strong_to_move ? 0 : 1);
+}
+
+TbPos tb_decode(int t, uint64_t idx) {
+	TbPos pos;
+	pos.strong_to_move = (idx & 1) == 0;
+	idx >>= 1;
+	if (t == TB_KPK) {
+		pos.wk = (int)(idx & 63); idx >>= 6;
+		pos.sk = (int)(idx & 63); idx >>= 6;
+		pos.p[0] = (int)((idx / 4 + 1) * 8 + idx % 4);
+		return pos;
+	}
+	for (int i=TB_NPIECES[t]-1; i>=0; --i) { pos.p[i] = (int)(idx & 63); idx >>= 6; }
+	pos.wk = (int)(idx & 63); idx >>= 6;
+	pos.sk = TRIANGLE_SQ[idx];
+	return pos;
+}
+
+uint64_t piece_attacks(int type, int sq, uint64_t occ) {
+	switch (type) {
+		case 1: return PAWN_ATTACKS[0][sq];
+		case 2: return KNIGHT_ATTACKS[sq];
+		case 3: return bishop_attacks(sq, occ);
+		case 4: return rook_attacks(sq, occ);
+		case 5: return queen_attacks(sq, occ);
+		default: return KING_ATTACKS[sq];
+	}
+}
+
+uint64_t occupancy(int t, const TbPos &pos) {
+	uint64_t occ = square_bb(pos.sk) | square_bb(pos.wk);
+	for (int i=0; i<TB_NPIECES[t]; ++i) occ |= square_bb(pos.p[i]);
+	return occ;
+}
+
+// Squares the strong side attacks, leaving out the piece on skip (a capture target).
+uint64_t strong_attacks(int t, const TbPos &pos, uint64_t occ, int skip = -1) {
+	uint64_t att = KING_ATTACKS[pos.sk];
+	for (int i=0; i<TB_NPIECES[t]; ++i) {
+		if (pos.p[i] != skip) att |= piece_attacks(TB_PIECES[t][i], pos.p[i], occ);
+	}
+	return att;
+}
+
+bool tb_valid(int t, const TbPos &pos) {
+	uint64_t occ = occupancy(t, pos);
+	if (popcount(occ) != 2 + TB_NPIECES[t]) return false; // two pieces on one square
+	if (KING_ATTACKS[pos.sk] & square_bb(pos.wk)) return false;
+	// the side not to move cannot be in check; only the weak king can be
+	return !pos.strong_to_move || !(strong_attacks(t, pos, occ) & square_bb(pos.wk));
+}
+
+enum WeakMoves { ALL_LOSE, SOME_HOLD, MATED, STALEMATE };
+
+// Weak side to move: whether each of its legal moves reaches a won position for the strong
+// side. Capturing a strong piece always holds, no table here is won with what remains.
+WeakMoves weak_moves(int t, const TbPos &pos, const std::vector<uint8_t> &val) {
+	const uint64_t occ = occupancy(t, pos);
+	const uint64_t occ_moved = occ ^ square_bb(pos.wk);
+	bool any = false;
+	for (uint64_t to = KING_ATTACKS[pos.wk] & ~square_bb(pos.sk); to; ) {
+		int sq = pop_lsb(to);
+		bool capture = (occ & square_bb(sq)) != 0;
+		if (strong_attacks(t, pos, occ_moved, capture ? sq : -1) & square_bb(sq)) continue;
+		if (capture) return SOME_HOLD;
+		any = true;
+		TbPos next = pos;
+		next.wk = sq;
+		next.strong_to_move = true;
+		if (val[tb_index(t, next)] != TB_WIN) return SOME_HOLD;
+	}
+	if (any) return ALL_LOSE;
+	return (strong_attacks(t, pos, occ) & square_bb(pos.wk)) ? MATED : STALEMATE;
+}
+
+// Retrograde analysis: start from the mates (and, for KPK, promotions into lost KQK/KRK
+// positions), then walk moves backwards. A strong-to-move predecessor of a lost position wins;
+// a weak-to-move predecessor of a won position loses once all its moves are checked to win.
+// Whatever is never reached is a draw.
+void generate(int t, std::vector<uint8_t> &val, const std::vector<uint8_t> *kqk, const std::vector<uint8_t> *krk) {
+	const uint64_t entries = TB_ENTRIES[t];
+	val.assign(entries, TB_DRAW);
+	std::deque<uint64_t> work;
+	for (uint64_t i=0; i<entries; ++i) {
+		TbPos pos = tb_decode(t, i);
+		if (tb_index(t, pos) != i || !tb_valid(t, pos)) val[i] = TB_INVALID; // the folded twin is stored instead
+	}
+	for (uint64_t i=0; i<entries; ++i) {
+		if (val[i] == TB_INVALID) continue;
+		TbPos pos = tb_decode(t, i);
+		if (!pos.strong_to_move) {
+			if (weak_moves(t, pos, val) == MATED) { val[i] = TB_LOSS; work.push_back(i); }
+		} else if (t == TB_KPK && (pos.p[0] >> 3) == 6 && !(occupancy(t, pos) & square_bb(pos.p[0] + 8))) {
+			// promotion, with the rook for the queen's stalemates
+			TbPos q = pos;
+			q.p[0] = pos.p[0] + 8;
+			q.strong_to_move = false;
+			if ((*kqk)[tb_index(TB_KQK, q)] == TB_LOSS || (*krk)[tb_index(TB_KRK, q)] == TB_LOSS) { val[i] = TB_WIN; work.push_back(i); }
+		}
+	}
+	while (!work.empty()) {
+		uint64_t i = work.front();
+		work.pop_front();
+		const TbPos pos = tb_decode(t, i);
+		const uint64_t occ = occupancy(t, pos);
+		if (!pos.strong_to_move) {
+			// un-move each strong piece
+			for (int k=-1; k<TB_NPIECES[t]; ++k) {
+				int from = k < 0 ? pos.sk : pos.p[k];
+				int type = k < 0 ? 6 : TB_PIECES[t][k];
+				uint64_t back;
+				if (type == 1) {
+					back = 0;
+					if ((from >> 3) >= 2 && !(occ & square_bb(from - 8))) {
+						back |= square_bb(from - 8);
+						if ((from >> 3) == 3 && !(occ & square_bb(from - 16))) back |= square_bb(from - 16);
+					}
+				} else {
+					back = piece_attacks(type, from, occ) & ~occ;
+				}
+				while (back) {
+					TbPos prev = pos;
+					(k < 0 ? prev.sk : prev.p[k]) = pop_lsb(back);
+					prev.strong_to_move = true;
+					uint64_t j = tb_index(t, prev);
+					if (val[j] == TB_DRAW && tb_valid(t, prev)) { val[j] = TB_WIN; work.push_back(j); }
+				}
+			}
+		} else {
+			// un-move the weak king, then check the predecessor's other moves
+			for (uint64_t back = KING_ATTACKS[pos.wk] & ~occ; back; ) {
+				TbPos prev = pos;
+				prev.wk = pop_lsb(back);
+				prev.strong_to_move = false;
+				uint64_t j = tb_index(t, prev);
+				if (val[j] == TB_DRAW && tb_valid(t, prev) && weak_moves(t, prev, val) == ALL_LOSE) { val[j] = TB_LOSS; work.push_back(j); }
+			}
+		}
+	}
+	for (uint8_t &v : val) if (v == TB_INVALID) v = TB_DRAW;
+}
+
+} // namespace
+
+void Egtb::set_data(const uint8_t *p) {
+	data = p;
+	size_t off = 0;
+	for (int t=0; t<TB_TABLES; ++t) { offset[t] = off; off += (TB_ENTRIES[t] + 3) / 4; }
+}
+
+void Egtb::build(std::ostream &log) {
+	close();
+	size_t bytes = 0;
+	for (int t=0; t<TB_TABLES; ++t) bytes += (TB_ENTRIES[t] + 3) / 4;
+	owned.assign(bytes, 0);
+	set_data(owned.data());
+	std::vector<uint8_t> val[TB_TABLES];
+	for (int t=0; t<TB_TABLES; ++t) {
+		auto start = std::chrono::steady_clock::now();
+		generate(t, val[t], &val[TB_KQK], &val[TB_KRK]); // KPK comes after both
+		uint64_t wins = 0, losses = 0;
+		uint8_t *out = owned.data() + offset[t];
+		for (uint64_t i=0; i<TB_ENTRIES[t]; ++i) {
+			wins += val[t][i] == TB_WIN;
+			losses += val[t][i] == TB_LOSS;
+			out[i >> 2] |= (uint8_t)(val[t][i] << ((i & 3) * 2));
+		}
+		log << "built " << TB_NAMES[t] << ": " << wins << " wins, " << losses << " losses for the side to move in "
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+	}
+}
+
+bool Egtb::save(const std::string &path) const {
+	if (!data) return false;
+	EgtbFileHeader h;
+	std::memcpy(h.magic, EGTB_MAGIC, 8);
+	h.version = EGTB_VERSION;
+	h.tables = TB_TABLES;
+	size_t bytes = 0;
+	for (int t=0; t<TB_TABLES; ++t) { h.entries[t] = TB_ENTRIES[t]; bytes += (TB_ENTRIES[t] + 3) / 4; }
+	std::string tmp = path + ".tmp." + std::to_string(getpid());
+	FILE *f = std::fopen(tmp.c_str(), "wb");
+	if (!f) return false;
+	bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 && std::fwrite(data, 1, bytes, f) == bytes;
+	ok = std::fflush(f) == 0 && ok;
+	ok = fsync(fileno(f)) == 0 && ok;
+	ok = std::fclose(f) == 0 && ok;
+	if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) { std::remove(tmp.c_str()); return false; }
+	return true;
+}
+
+bool Egtb::open(const std::string &path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(EgtbFileHeader)) { ::close(fd); return false; }
+	void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd); // the mapping keeps the file alive
+	if (p == MAP_FAILED) return false;
+	const EgtbFileHeader *h = (const EgtbFileHeader*)p;
+	size_t bytes = sizeof(EgtbFileHeader);
+	bool ok = std::memcmp(h->magic, EGTB_MAGIC, 8) == 0 && h->version == EGTB_VERSION && h->tables == TB_TABLES;
+	for (int t=0; t<TB_TABLES && ok; ++t) { ok = h->entries[t] == TB_ENTRIES[t]; bytes += (TB_ENTRIES[t] + 3) / 4; }
+	if (!ok || (size_t)st.st_size != bytes) { munmap(p, (size_t)st.st_size); return false; }
+	map = p;
+	map_len = (size_t)st.st_size;
+	set_data((const uint8_t*)(h + 1));
+	return true;
+}
+
+void Egtb::close() {
+	if (map) munmap(map, map_len);
+	map = nullptr; map_len = 0;
+	owned.clear();
+	owned.shrink_to_fit();
+	data = nullptr;
+}
+
+bool Egtb::probe(const Board &b, int &wdl) const {
+	if (!data || popcount(b.occupied) > 4 || b.castling_rights) return false;
+	// the strong side is the one with more than its king
+	const bool white_strong = popcount(b.colors[0]) > 1;
+	const int s = white_strong ? 1 : -1;
+	if (popcount(b.colors[white_strong ? 1 : 0]) != 1) return false;
+	int t;
+	const int pieces = popcount(b.occupied) - 2;
+	if (pieces == 1 && b.bb((Piece)(s * WR))) t = TB_KRK;
+	else if (pieces == 1 && b.bb((Piece)(s * WQ))) t = TB_KQK;
+	else if (pieces == 1 && b.bb((Piece)(s * WP))) t = TB_KPK;
+	else if (pieces == 2 && b.bb((Piece)(s * WB)) && b.bb((Piece)(s * WN))) t = TB_KBNK;
+	else return false;
+	const int flip = white_strong ? 0 : 56; // black strong: mirror so its pawn runs up the board
+	TbPos pos;
+	pos.sk = b.king_sq[white_strong ? 0 : 1] ^ flip;
+	pos.wk = b.king_sq[white_strong ? 1 : 0] ^ flip;
+	for (int i=0; i<TB_NPIECES[t]; ++i) pos.p[i] = lsb(b.bb((Piece)(s * TB_PIECES[t][i]))) ^ flip;
+	pos.strong_to_move = b.white_to_move == white_strong;
+	uint64_t i = tb_index(t, pos);
+	int v = (data[offset[t] + (i >> 2)] >> ((i & 3) * 2)) & 3;
+	wdl = v == TB_WIN ? 1 : v == TB_LOSS ? -1 : 0;
+	return true;
+}
+
+void load_or_build_egtb(Egtb &tb, const std::string &path, std::ostream &log) {
+	if (tb.open(path)) return;
+	log << "building endgame tables\n";
+	tb.build(log);
+	if (!tb.save(path)) log << "could not write " << path << ", tables kept in memory\n";
+}
@@ -0,0 +1,133 @@
+#include "evaluator.hpp"
+#include "stats.hpp"
+
+static constexpr float PLAYOUT_EPSILON = 0.1f;
+static constexpr int PLAYOUT_NOISE = 20; // centipawns
+static constexpr int CHECK_BONUS = 50;
+
+static int playout_score(const Board &b, const Move &m) {
+	const bool white = b.white_to_move;
+	const Piece p = b.squares[m.from];
+	int t = (m.flags & 4) ? (m.promotion < 0 ? -m.promotion : m.promotion) : abs_piece(p);
+	int s = 0;
+	if (b.squares[m.to] != EMPTY || (m.flags & 6) || (PAWN_ATTACKS[white ? 0 : 1][m.to] & b.bb(white ? BP : WP))) s = b.see(m);
+	const uint64_t king = square_bb(b.king_sq[white ? 1 : 0]);
+	const uint64_t occ = (b.occupied ^ square_bb(m.from)) | square_bb(m.to);
+	uint64_t att = 0;
+	switch (t) {
+		case 1: att = PAWN_ATTACKS[white ? 0 : 1][m.to]; break;
+		case 2: att = KNIGHT_ATTACKS[m.to]; break;
+		case 3: att = bishop_attacks(m.to, occ); break;
+		case 4: att = rook_attacks(m.to, occ); break;
+		case 5: att = queen_attacks(m.to, occ); break;
+		default: break;
+	}
+	if (att & king) s += CHECK_BONUS;
+	return s;
+}
+
+// Stops early on anything that settles the result: mate, stalemate, the 50-move rule, a
+// repetition (one is enough inside a playout), insufficient material or a lasting material margin.
+float PlayoutEvaluator::playout(Board &b) const {
+	STAT_TIMER(TM_PLAYOUT);
+	MoveList moves;
+	int lead = 0; // consecutive plies at or over the margin: > 0 white ahead, < 0 black ahead
+	for (int depth=0; depth<opt.max_plies; ++depth) {
+		b.generate_legal_moves(moves);
+		if (moves.empty()) {
+			// checkmate or stalemate, same verdict as evaluate_terminal without a second movegen
+			if (b.in_check(b.white_to_move)) return b.white_to_move ? -1.0f : 1.0f;
+			return 0.0f;
+		}
+		if (b.halfmove_clock >= 100 || b.is_repetition(1) || b.insufficient_material()) return 0.0f;
+		int wdl;
+		if (egtb && popcount(b.occupied) <= 4 && egtb->probe(b, wdl)) {
+			STAT_ADD(ST_EGTB_HITS, 1);
+			return (float)(b.white_to_move ? wdl : -wdl);
+		}
+		if (opt.adjudicate_cp > 0) {
+			int margin = b.material_eval();
+			if (margin >= opt.adjudicate_cp) lead = lead > 0 ? lead + 1 : 1;
+			else if (margin <= -opt.adjudicate_cp) lead = lead < 0 ? lead - 1 : -1;
+			else lead = 0;
+			if (std::abs(lead) >= opt.adjudicate_plies) return std::max(-1.0f, std::min(1.0f, margin / (2.0f * opt.adjudicate_cp)));
+		}
+		size_t pick = 0;
+		if (GLOBAL_RNG.uniform01f() < PLAYOUT_EPSILON) {
+			pick = GLOBAL_RNG.below((uint32_t)moves.size());
+		} else {
+			int best = std::numeric_limits<int>::min();
+			for (size_t i=0;i<moves.size();++i) {
+				int s = playout_score(b, moves[i]) + (int)GLOBAL_RNG.below(PLAYOUT_NOISE);
+				if (s > best) { best = s; pick = i; }
+			}
+		}
+		b.make_move(moves[pick]);
+	}
+	return 0.0f;
+}
+
+namespace {
+
+// Playouts are sequential by nature, so each runs as soon as its leaf is staged.
+class PlayoutBatch : public LeafBatch {
+public:
+	PlayoutBatch(const PlayoutEvaluator &e, size_t capacity) : ev(e) { vals.reserve(capacity); }
+	void add(Board &b) override {
+		const bool white = b.white_to_move;
+		size_t base = b.ply();
+		float r = ev.playout(b);
+		STAT_ADD(ST_PLAYOUT_PLIES, b.ply() - base);
+		b.unmake_to(base);
+		vals.push_back(white ? r : -r);
+	}
+	void evaluate(float *out) override {
+		std::copy(vals.begin(), vals.end(), out);
+		vals.clear();
+	}
+
+private:
+	const PlayoutEvaluator &ev;
+	std::vector<float> vals;
+};
+
+class MaterialBatch : public LeafBatch {
+public:
+	explicit MaterialBatch(size_t capacity) { vals.reserve(capacity); }
+	void add(Board &b) override {
+		float v = std::tanh(b.material_eval() / MaterialEvaluator::MATERIAL_SCALE_CP);
+		vals.push_back(b.white_to_move ? v : -v);
+	}
+	void evaluate(float *out) override {
+		std::copy(vals.begin(), vals.end(), out);
+		vals.clear();
+	}
+
+private:
+	std::vector<float> vals;
+};
+
+class NnueBatch : public LeafBatch {
+public:
+	NnueBatch(const Nnue &n, size_t capacity) : net(n) { acc.reserve(capacity); us.reserve(capacity); }
+	void add(Board &b) override {
+		acc.push_back(b.nnue_acc.back());
+		us.push_back(b.white_to_move ? 0 : 1);
+	}
+	void evaluate(float *out) override {
+		net.evaluate_batch(acc.data(), us.data(), acc.size(), out);
+		acc.clear();
+		us.clear();
+	}
+
+private:
+	const Nnue &net;
+	std::vector<NnueAccumulator> acc;
+	std::vector<uint8_t> us;
+};
+
+} // namespace
+
+std::unique_ptr<LeafBatch> PlayoutEvaluator::new_batch(size_t capacity) const { return std::unique_ptr<LeafBatch>(new PlayoutBatch(*this, capacity)); }
+std::unique_ptr<LeafBatch> MaterialEvaluator::new_batch(size_t capacity) const { return std::unique_ptr<LeafBatch>(new MaterialBatch(capacity)); }
+std::unique_ptr<LeafBatch> NnueEvaluator::new_batch(size_t capacity) const { return std::unique_ptr<LeafBatch>(new NnueBatch(net, capacity)); }
@@ -1,4 +1,12 @@
 #include "mcts.hpp"
+#include "analyze.hpp"
+#include "book.hpp"
+#include "perft.hpp"
+#include "bench.hpp"
+#include "selfplay.hpp"
+#include "stats.hpp"
+#include "uci.hpp"
+#include <thread>
 
 static void print_board(const Board &b) {
 	for (int r=7;r>=0;--r) {
@@ -27,16 +35,231 @@ static int sq_from_algebraic(const std::string &s) {
 	return idx(r,f);
 }
 
+// chess_rl bench [--json FILE] [--baseline FILE] [--threshold PCT]
+// Exit status 1 when a rate fell more than PCT (default 5) below the baseline.
+static int bench_main(int argc, char** argv) {
+	std::string json_path, baseline_path;
+	double threshold = 5.0;
+	for (int i=2; i<argc; ++i) {
+		std::string a = argv[i];
+		if (a=="--json" && i+1<argc) json_path = argv[++i];
+		else if (a=="--baseline" && i+1<argc) baseline_path = argv[++i];
+		else if (a=="--threshold" && i+1<argc) threshold = std::atof(argv[++i]);
+		else { std::cerr<<"usage: chess_rl bench [--json FILE] [--baseline FILE] [--threshold PCT]\n"; return 2; }
+	}
+	BenchResult base;
+	if (!baseline_path.empty() && !bench_from_json(baseline_path, base)) { std::cerr<<"cannot read baseline "<<baseline_path<<"\n"; return 2; }
+	BenchResult r = run_bench(std::cerr);
+	std::string json = bench_to_json(r);
+	std::cout<<json<<"\n";
+	if (!json_path.empty()) {
+		std::ofstream out(json_path);
+		if (!(out<<json<<"\n")) { std::cerr<<"cannot write "<<json_path<<"\n"; return 2; }
+	}
+	if (baseline_path.empty()) return 0;
+	return bench_compare(r, base, threshold, std::cerr) ? 0 : 1;
+}
+
+// The leaf evaluator chosen by --eval and --nnue; a network file wins over --eval.
+struct EvaluatorChoice {
+	std::string kind = "playout", nnue_path;
+	Nnue net;
+	MaterialEvaluator material;
+	std::unique_ptr<NnueEvaluator> nnue;
+
+	// Null for playouts, which MCTS runs itself with its playout options.
+	bool resolve(const LeafEvaluator *&out) {
+		out = nullptr;
+		if (!nnue_path.empty()) {
+			if (!net.load(nnue_path)) { std::cerr<<"cannot load network "<<nnue_path<<"\n"; return false; }
+			nnue.reset(new NnueEvaluator(net));
+			out = nnue.get();
+		}
+		else if (kind == "material") out = &material;
+		else if (kind != "playout") { std::cerr<<"unknown evaluator "<<kind<<" (playout or material)\n"; return false; }
+		return true;
+	}
+};
+
+static const char *ANALYZE_USAGE = "usage: chess_rl analyze <epd-file|-> [--workers N] [--sims N] [--movetime MS] [--hash-mb N] [--seed N] [--eval playout|material] [--nnue FILE] [--batch K] [--egtb FILE] [--out FILE]\n";
+
+static int analyze_main(int argc, char** argv) {
+	AnalyzeOptions opt;
+	opt.workers = std::max(1u, std::thread::hardware_concurrency());
+	std::string in_path, out_path, egtb_path;
+	EvaluatorChoice eval;
+	for (int i=2; i<argc; ++i) {
+		std::string a = argv[i];
+		if (a=="--workers" && i+1<argc) opt.workers = std::max(1, std::atoi(argv[++i]));
+		else if (a=="--sims" && i+1<argc) opt.simulations = std::atoi(argv[++i]);
+		else if (a=="--movetime" && i+1<argc) opt.movetime_ms = std::atoll(argv[++i]);
+		else if (a=="--hash-mb" && i+1<argc) opt.hash_mb = (size_t)std::max(1, std::atoi(argv[++i]));
+		else if (a=="--seed" && i+1<argc) opt.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (a=="--out" && i+1<argc) out_path = argv[++i];
+		else if (a=="--eval" && i+1<argc) eval.kind = argv[++i];
+		else if (a=="--nnue" && i+1<argc) eval.nnue_path = argv[++i];
+		else if (a=="--batch" && i+1<argc) opt.batch = std::max(1, std::atoi(argv[++i]));
+		else if (a=="--egtb" && i+1<argc) egtb_path = argv[++i];
+		else if (in_path.empty() && (a=="-" || a[0]!='-')) in_path = a;
+		else { std::cerr<<ANALYZE_USAGE; return 2; }
+	}
+	if (in_path.empty() || (opt.simulations <= 0 && opt.movetime_ms <= 0)) { std::cerr<<ANALYZE_USAGE; return 2; }
+	if (!eval.resolve(opt.evaluator)) return 2;
+	Egtb egtb;
+	if (!egtb_path.empty()) {
+		load_or_build_egtb(egtb, egtb_path, std::cerr);
+		opt.egtb = &egtb;
+	}
+	std::ifstream fin;
+	if (in_path != "-") {
+		fin.open(in_path);
+		if (!fin) { std::cerr<<"cannot read "<<in_path<<"\n"; return 2; }
+	}
+	std::ofstream fout;
+	if (!out_path.empty()) {
+		fout.open(out_path);
+		if (!fout) { std::cerr<<"cannot write "<<out_path<<"\n"; return 2; }
+	}
+	std::ios::sync_with_stdio(false);
+	AnalyzeStats st = run_analyze(in_path == "-" ? std::cin : fin, out_path.empty() ? std::cout : fout, opt);
+	std::cerr<<"analyzed "<<st.positions<<" positions ("<<st.errors<<" errors) in "<<st.seconds<<" s, "
+		<<(uint64_t)(st.positions / std::max(st.seconds, 1e-9))<<" positions/s\n";
+	if (!out_path.empty() && !fout) { std::cerr<<"cannot write "<<out_path<<"\n"; return 1; }
+	return 0;
+}
+
+static const char *TRAIN_NNUE_USAGE = "usage: chess_rl train-nnue <train-file> <out-file> [--epochs N] [--batch N] [--lr X] [--seed N]\n";
+
+static int train_nnue_main(int argc, char** argv) {
+	NnueTrainOptions opt;
+	std::vector<std::string> paths;
+	for (int i=2; i<argc; ++i) {
+		std::string a = argv[i];
+		if (a=="--epochs" && i+1<argc) opt.epochs = std::max(1, std::atoi(argv[++i]));
+		else if (a=="--batch" && i+1<argc) opt.batch = std::max(1, std::atoi(argv[++i]));
+		else if (a=="--lr" && i+1<argc) opt.lr = (float)std::atof(argv[++i]);
+		else if (a=="--seed" && i+1<argc) opt.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (a[0] != '-') paths.push_back(a);
+		else { std::cerr<<TRAIN_NNUE_USAGE; return 2; }
+	}
+	if (paths.size() != 2) { std::cerr<<TRAIN_NNUE_USAGE; return 2; }
+	Nnue net;
+	if (!train_nnue(paths[0], opt, net, std::cout)) { std::cerr<<"no training records in "<<paths[0]<<"\n"; return 1; }
+	if (!net.save(paths[1])) { std::cerr<<"cannot write "<<paths[1]<<"\n"; return 1; }
+	std::cout<<"saved "<<paths[1]<<"\n";
+	return 0;
+}
+
+static const char *BUILD_BOOK_USAGE = "usage: chess_rl build-book [--q FILE] [--records FILE]... [--plies N] [--min-visits N] [--max-moves N] [--out FILE]\n";
+
+static int build_book_main(int argc, char** argv) {
+	BookBuildOptions opt;
+	std::string q_path = "data/qtable.bin", out_path = "data/book.bin";
+	std::vector<std::string> record_paths;
+	for (int i=2; i<argc; ++i) {
+		std::string a = argv[i];
+		if (a=="--q" && i+1<argc) q_path = argv[++i];
+		else if (a=="--records" && i+1<argc) record_paths.push_back(argv[++i]);
+		else if (a=="--plies" && i+1<argc) opt.max_plies = std::max(1, std::atoi(argv[++i]));
+		else if (a=="--min-visits" && i+1<argc) opt.min_visits = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (a=="--max-moves" && i+1<argc) opt.max_moves = std::max(1, std::atoi(argv[++i]));
+		else if (a=="--out" && i+1<argc) out_path = argv[++i];
+		else { std::cerr<<BUILD_BOOK_USAGE; return 2; }
+	}
+	BookBuilder builder(opt);
+	QFile q;
+	if (q.open(q_path)) {
+		builder.add_qfile(q);
+		std::cout<<"Q-table "<<q_path<<": "<<q.size()<<" entries\n";
+	}
+	else if (record_paths.empty()) { std::cerr<<"cannot read Q-table "<<q_path<<"\n"; return 1; }
+	for (auto &path : record_paths) {
+		TrainReader r;
+		if (!r.open(path)) { std::cerr<<"cannot read "<<path<<"\n"; return 1; }
+		uint64_t n = builder.add_records(r);
+		std::cout<<path<<": "<<n<<" records\n";
+		if (r.corrupt()) { std::cerr<<path<<": corrupt record at byte "<<r.offset()<<"\n"; return 1; }
+	}
+	uint64_t positions = 0, entries = 0;
+	if (!builder.write(out_path, positions, entries)) { std::cerr<<"cannot write "<<out_path<<"\n"; return 1; }
+	std::cout<<"saved "<<out_path<<": "<<positions<<" positions, "<<entries<<" moves\n";
+	return 0;
+}
+
 int main(int argc, char** argv) {
+	if (argc > 1 && std::string(argv[1]) == "bench") return bench_main(argc, argv);
+	if (argc > 1 && std::string(argv[1]) == "analyze") return analyze_main(argc, argv);
+	if (argc > 1 && std::string(argv[1]) == "train-nnue") return train_nnue_main(argc, argv);
+	if (argc > 1 && std::string(argv[1]) == "build-book") return build_book_main(argc, argv);
+	// usage: chess_rl [games] [--hash-mb N] [--q-capacity N] [--adjudicate CP PLIES] [--seed N] [--record FILE] [--eval playout|material] [--nnue FILE] [--batch K] [--clock MS INC] [--no-egtb] [--book FILE] [--no-book] [--book-min VISITS SHARE]
+	int default_games = 500;
+	size_t hash_mb = 64;
+	size_t q_capacity = 1 << 21;
+	PlayoutOptions playout;
+	bool seeded = false;
+	uint64_t seed = 0;
+	std::string record_path;
+	EvaluatorChoice eval;
+	int batch = 1;
+	int64_t clock_ms = 0, increment_ms = 0;
+	bool use_egtb = true;
+	std::string book_path = "data/book.bin";
+	BookOptions book_opt;
+	for (int i=1; i<argc; ++i) {
+		std::string a = argv[i];
+		if (a=="--hash-mb" && i+1<argc) hash_mb = (size_t)std::max(1, std::atoi(argv[++i]));
+		else if (a=="--q-capacity" && i+1<argc) q_capacity = (size_t)std::strtoull(argv[++i], nullptr, 10);
+		else if (a=="--record" && i+1<argc) record_path = argv[++i];
+		else if (a=="--eval" && i+1<argc) eval.kind = argv[++i];
+		else if (a=="--nnue" && i+1<argc) eval.nnue_path = argv[++i];
+		else if (a=="--batch" && i+1<argc) batch = std::max(1, std::atoi(argv[++i]));
+		else if (a=="--no-egtb") use_egtb = false;
+		else if (a=="--book" && i+1<argc) book_path = argv[++i];
+		else if (a=="--no-book") book_path.clear();
+		else if (a=="--book-min" && i+2<argc) { book_opt.min_visits = (uint32_t)std::strtoul(argv[++i], nullptr, 10); book_opt.min_share = (float)std::atof(argv[++i]); }
+		else if (a=="--clock" && i+2<argc) { clock_ms = std::max<int64_t>(0, std::atoll(argv[++i])); increment_ms = std::max<int64_t>(0, std::atoll(argv[++i])); }
+		else if (a=="--seed" && i+1<argc) { seed = std::strtoull(argv[++i], nullptr, 10); seeded = true; }
+		else if (a=="--adjudicate" && i+2<argc) { playout.adjudicate_cp = std::max(0, std::atoi(argv[++i])); playout.adjudicate_plies = std::max(1, std::atoi(argv[++i])); }
+		else default_games = std::atoi(argv[i]);
+	}
+	if (seeded) seed_rngs(seed);
+	TrainWriter record;
+	if (!record_path.empty() && !record.open(record_path)) { std::cerr<<"cannot record to "<<record_path<<"\n"; return 2; }
+	const LeafEvaluator *evaluator;
+	if (!eval.resolve(evaluator)) return 2;
+	Egtb egtb;
+	if (use_egtb) load_or_build_egtb(egtb, "data/egtb.bin", std::cout);
+	const Egtb *tables = use_egtb ? &egtb : nullptr;
+	Book book; // an absent book only means every move is searched
+	if (!book_path.empty() && book.open(book_path)) std::cout<<"Opening book "<<book_path<<": "<<book.size()<<" moves\n";
 	Board b = Board::startpos();
-	MCTS mcts;
+	MCTS mcts(hash_mb);
 	mcts.enable_persistent_q(true);
-	const std::string qfile = "data/qtable.txt";
-	mcts.load_qtable(qfile);
-	std::cout << "Type: play, train, selfplay, or quit\n";
+	mcts.set_q_capacity(q_capacity);
+	mcts.set_playout_options(playout);
+	mcts.set_evaluator(evaluator);
+	mcts.set_batch_size(batch);
+	mcts.set_egtb(tables);
+	mcts.set_early_stop(true); // play, selfplay and uci stop searching once the move is decided
+	std::string qfile = "data/qtable.bin";
+	mcts.load_qtable(qfile); // a missing table starts empty
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << "Type: play, train [games] [workers] [seed], selfplay, perft <depth> [fen], scaling [sims], batching [sims], or quit\n";
 	std::string cmd;
 	while (std::cin>>cmd) {
 		if (cmd=="quit") break;
+		if (cmd=="uci") {
+			// hand the session to a GUI; the REPL does not come back
+			UciSettings us;
+			us.threads = threads;
+			us.hash_mb = hash_mb;
+			us.qfile = qfile;
+			us.book = &book;
+			us.book_opt = book_opt;
+			uci_loop(mcts, us, std::cin, std::cout);
+			qfile = us.qfile;
+			break;
+		}
 		if (cmd=="play") {
 			b = Board::startpos();
 			while (true) {
@@ -44,41 +267,88 @@ int main(int argc, char** argv) {
 				GameResult g = b.evaluate_terminal();
 				if (g.terminal) { std::cout<<"Game over score="<<g.reward<<"\n"; break; }
 				if (b.white_to_move) {
-					std::cout<<"Enter move like e2e4: "; std::string mv; if(!(std::cin>>mv)) return 0; if(mv.size()<4) continue; int from=sq_from_algebraic(mv.substr(0,2)); int to=sq_from_algebraic(mv.substr(2,2)); if(from<0||to<0) continue; auto ms=b.generate_legal_moves(); bool done=false; for(auto &m:ms){ if(m.from==from && m.to==to){ Piece cap; uint8_t oc; int8_t oe; uint16_t oh; b.make_move(m,cap,oc,oe,oh); done=true; break; } } if(!done) std::cout<<"Illegal\n";
+					std::cout<<"Enter move like e2e4: "; std::string mv; if(!(std::cin>>mv)) return 0; if(mv.size()<4) continue; int from=sq_from_algebraic(mv.substr(0,2)); int to=sq_from_algebraic(mv.substr(2,2)); if(from<0||to<0) continue; MoveList ms; b.generate_legal_moves(ms); bool done=false; for(auto &m:ms){ if(m.from==from && m.to==to){ b.make_move(m); done=true; break; } } if(!done) std::cout<<"Illegal\n";
 				} else {
-					Move best = mcts.search_best_move(b, 1500, 1.2f);
-					Piece cap; uint8_t oc; int8_t oe; uint16_t oh; b.make_move(best,cap,oc,oe,oh);
+					Move best;
+					if (book.pick(b, book_opt, best)) std::cout<<"Book move "<<move_to_uci(best)<<"\n";
+					else {
+						mcts.reroot(b); // keep what the last search learned about this position
+						STATS_RESET();
+						best = mcts.search_best_move(b, 1500, 1.2f, threads);
+						STATS_DUMP(std::cout);
+					}
+					b.make_move(best);
 				}
 			}
 		}
 		if (cmd=="train") {
-			int games = 500; if (argc>1) games = std::atoi(argv[1]);
-			int white_wins=0, black_wins=0, draws=0;
-			for (int g=0; g<games; ++g) {
-				b = Board::startpos();
-				for (int ply=0; ply<512; ++ply) {
-					GameResult gr = b.evaluate_terminal(); if (gr.terminal) { if (gr.reward>0) ++white_wins; else if (gr.reward<0) ++black_wins; else ++draws; break; }
-					Move mv = mcts.search_best_move(b, 48, 1.2f);
-					Piece cap; uint8_t oc; int8_t oe; uint16_t oh; b.make_move(mv,cap,oc,oe,oh);
-				}
-			}
-			std::cout<<"W:"<<white_wins<<" B:"<<black_wins<<" D:"<<draws<<"\n";
+			// train [games] [workers] [seed]
+			std::string line; std::getline(std::cin, line);
+			std::istringstream in(line);
+			SelfPlayOptions opt;
+			opt.games = default_games;
+			opt.workers = threads;
+			opt.seed = GLOBAL_RNG.u64(); // reproducible under --seed
+			int n; uint64_t s;
+			if (in >> n) opt.games = n;
+			if (in >> n) opt.workers = std::max(1, n);
+			if (in >> s) opt.seed = s;
+			opt.hash_mb = std::max<size_t>(1, hash_mb / opt.workers);
+			opt.playout = playout;
+			if (!record_path.empty()) opt.record = &record;
+			opt.evaluator = evaluator;
+			opt.batch = batch;
+			opt.egtb = tables;
+			opt.clock_ms = clock_ms;
+			opt.increment_ms = increment_ms;
+			std::cout<<"seed "<<opt.seed<<"\n";
+			STATS_RESET();
+			SelfPlayStats st = run_selfplay(mcts, opt, std::cout);
+			std::cout<<"W:"<<st.white_wins<<" B:"<<st.black_wins<<" D:"<<st.draws<<"\n";
+			if (clock_ms > 0) std::cout<<"lost on time: "<<st.time_losses<<", worst overrun of a hard limit: "<<st.worst_overrun_ms<<" ms\n";
+			STATS_DUMP(std::cout);
+		}
+		if (cmd=="perft") {
+			std::string line; std::getline(std::cin, line);
+			std::istringstream in(line);
+			int depth = 0; std::string fen;
+			in >> depth; std::getline(in >> std::ws, fen);
+			Board pb = Board::startpos();
+			if (!fen.empty() && !pb.set_fen(fen)) std::cout<<"Bad FEN\n";
+			else { PerftOptions opt; opt.divide = true; run_perft(pb, depth, opt, std::cout); }
+		}
+		if (cmd=="scaling") {
+			std::string line; std::getline(std::cin, line);
+			int sims = std::atoi(line.c_str());
+			bench_thread_scaling(sims > 0 ? sims : 4000, std::cout);
+		}
+		if (cmd=="batching") {
+			std::string line; std::getline(std::cin, line);
+			int sims = std::atoi(line.c_str());
+			bench_batch_sizes(sims > 0 ? sims : 4000, evaluator, 1, std::cout);
 		}
 		if (cmd=="selfplay") {
 			b = Board::startpos();
 			int move_num = 1;
+			STATS_RESET();
 			while (true) {
 				print_board(b);
 				GameResult g = b.evaluate_terminal();
-				if (g.terminal) { std::cout<<"Game over score="<<g.reward<<"\n"; break; }
-				Move mv = mcts.search_best_move(b, 128, 1.2f);
-				std::cout << (b.white_to_move?"White":"Black") << " plays move #" << move_num << "\n";
-				Piece cap; uint8_t oc; int8_t oe; uint16_t oh; b.make_move(mv,cap,oc,oe,oh);
+				if (g.terminal) { std::cout<<"Game over score="<<g.reward<<"\n"; STATS_DUMP(std::cout); break; }
+				Move mv;
+				bool booked = book.pick(b, book_opt, mv);
+				if (!booked) {
+					mcts.reroot(b);
+					mv = mcts.search_best_move(b, 128, 1.2f, threads);
+				}
+				std::cout << (b.white_to_move?"White":"Black") << " plays move #" << move_num << (booked ? " from the book" : "") << "\n";
+				b.make_move(mv);
 				++move_num;
 			}
 		}
-		std::cout<<"Type: play, train, selfplay, or quit\n";
+		std::cout<<"Type: play, train [games] [workers] [seed], selfplay, perft <depth> [fen], scaling [sims], batching [sims], or quit\n";
 	}
-	mcts.save_qtable(qfile);
+	if (!mcts.save_qtable(qfile)) std::cout<<"Could not save "<<qfile<<"\n";
+	if (!record.close()) std::cout<<"Could not write "<<record_path<<"\n";
 	return 0;
 }
\ No newline at end of file
@@ -1,154 +1,401 @@
 #include "mcts.hpp"
+#include "stats.hpp"
+#include "ucb.hpp"
 #include <chrono>
+#include <thread>
 
-MCTS::MCTS() : time_budget_ms(0), persistent_q(true) {}
+MCTS::MCTS(size_t hash_mb) : nodes(hash_mb), qbase(nullptr), q_capacity(0), early_stop(false), stop_flag(nullptr), info_interval_ms(1000), persistent_q(true), evaluator(&playouts), egtb(nullptr), batch_size(1), c_puct(1.4f) {}
 
-void MCTS::set_time_budget_ms(int64_t ms) { time_budget_ms = ms; }
+void MCTS::set_time_budget_ms(int64_t ms) { time_plan.soft_ms = time_plan.hard_ms = std::max<int64_t>(0, ms); }
+void MCTS::set_time_plan(const TimePlan &plan) { time_plan = plan; }
+void MCTS::set_early_stop(bool enabled) { early_stop = enabled; }
+void MCTS::set_stop_flag(const std::atomic<bool> *flag) { stop_flag = flag; }
+void MCTS::set_info_callback(std::function<void(const SearchInfo&)> cb, int64_t interval_ms) { info_cb = std::move(cb); info_interval_ms = std::max<int64_t>(1, interval_ms); }
 void MCTS::enable_persistent_q(bool enabled) { persistent_q = enabled; }
+void MCTS::set_playout_options(const PlayoutOptions &opt) { playouts.opt = opt; }
+void MCTS::set_evaluator(const LeafEvaluator *ev) { evaluator = ev ? ev : &playouts; }
+void MCTS::set_batch_size(int k) { batch_size = std::max(1, k); }
+void MCTS::set_egtb(const Egtb *tb) { egtb = tb; playouts.egtb = tb; }
 
-void MCTS::load_qtable(const std::string &path) {
+bool MCTS::load_qtable(const std::string &path) {
 	qtable.clear();
-	std::ifstream in(path);
-	if (!in) return;
-	uint64_t h; float s; uint32_t v;
-	while (in >> h >> s >> v) qtable[h] = {s,v};
+	return qfile.open(path);
 }
 
-void MCTS::save_qtable(const std::string &path) {
-	std::ofstream out(path);
-	for (auto &kv : qtable) out << kv.first << ' ' << kv.second.first << ' ' << kv.second.second << '\n';
+bool MCTS::save_qtable(const std::string &path) {
+	std::lock_guard<std::mutex> g(qtable_mu);
+	if (!write_qfile(path, &qfile, qtable, q_capacity)) return false;
+	// everything is in the new file now; drop the old mapping and the folded-in updates
+	qtable.clear();
+	return qfile.open(path);
 }
 
-static inline float ucb_score(uint32_t parent_visits, uint32_t child_visits, float child_value, float c_puct) {
-	if (child_visits == 0) return 1e9f; // avoid inf under -ffast-math
-	float q = child_value / (float)child_visits;
-	float u = c_puct * std::sqrt(std::max(1u, parent_visits)) / (1.0f + child_visits);
-	return q + u;
+void MCTS::set_q_capacity(size_t entries) { q_capacity = entries; }
+void MCTS::attach_qbase(const MCTS *base) { qbase = base; }
+
+void MCTS::add_q_unlocked(uint64_t hash, std::pair<float,uint32_t> &acc) const {
+	if (const QRecord *r = qfile.probe(hash)) { acc.first += r->value_sum; acc.second += r->visits; }
+	auto it = qtable.find(hash);
+	if (it != qtable.end()) { acc.first += it->second.first; acc.second += it->second.second; }
 }
 
-Move MCTS::search_best_move(Board &root, int simulations, float c_puct) {
-	auto deadline = time_budget_ms > 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds(time_budget_ms) : std::chrono::steady_clock::time_point::max();
-	for (int i=0; i<simulations || std::chrono::steady_clock::now() < deadline; ++i) {
-		Board b = root;
-		float v = simulate(b);
-		(void)v;
+void MCTS::merge_q_into(QTable &dst) {
+	std::lock_guard<std::mutex> g(qtable_mu);
+	for (auto &kv : qtable) {
+		auto &q = dst[kv.first];
+		q.first += kv.second.first;
+		q.second += kv.second.second;
 	}
-	// pick move with max visits
-	MCTSNodeKey k{root.hash};
-	auto it = table.find(k);
-	if (it == table.end() || it->second.moves.empty()) {
-		auto legal = root.generate_legal_moves();
-		if (legal.empty()) return Move{0,0,0,0};
-		return legal[(size_t)(GLOBAL_RNG.uniform01()*legal.size())];
+	qtable.clear();
+}
+
+void MCTS::merge_q_from(const QTable &src) {
+	std::lock_guard<std::mutex> g(qtable_mu);
+	for (auto &kv : src) {
+		auto &q = qtable[kv.first];
+		q.first += kv.second.first;
+		q.second += kv.second.second;
 	}
-	MCTSNodeData &node = it->second;
-	uint32_t best_v = 0; size_t best_i = 0;
-	for (size_t i=0;i<node.moves.size();++i) {
-		if (node.child_visits[i] > best_v) { best_v = node.child_visits[i]; best_i = i; }
+	if (q_capacity) prune_qtable(qtable, q_capacity, &qfile);
+}
+
+// One lock and one hashed add per buffered update, instead of per path node in backprop.
+void MCTS::flush_q(std::vector<QUpdate> &qbuf) {
+	if (qbuf.empty()) return;
+	STAT_TIMER(TM_Q_FLUSH);
+	std::lock_guard<std::mutex> g(qtable_mu);
+	for (const QUpdate &u : qbuf) {
+		auto &q = qtable[u.hash];
+		q.first += u.value; // sum
+		q.second += 1; // visits
 	}
-	return node.moves[best_i];
+	qbuf.clear();
+	// shrink with slack so eviction is not paid on every flush
+	if (q_capacity && qtable.size() > q_capacity) prune_qtable(qtable, q_capacity - q_capacity / 8, &qfile);
 }
 
-float MCTS::simulate(Board &b) {
-	std::vector<std::pair<MCTSNodeKey,size_t>> path;
-	while (true) {
-		MCTSNodeKey k{b.hash};
-		auto tit = table.find(k);
-		if (tit == table.end()) {
-			// expand
-			MCTSNodeData nd{};
-			nd.visits = 0;
-			nd.value_sum = 0.0f;
-			nd.moves = b.generate_legal_moves();
-			nd.child_visits.assign(nd.moves.size(), 0);
-			nd.child_values.assign(nd.moves.size(), 0.0f);
-			// seed from persistent q if enabled
-			if (persistent_q) {
-				auto itq = qtable.find(k.hash);
-				if (itq != qtable.end()) {
-					nd.value_sum = itq->second.first;
-					nd.visits = itq->second.second;
-				}
-				// intentionally skip per-child seeding for speed
+void MCTS::clear_tree() { nodes.clear(); }
+void MCTS::set_hash_mb(size_t mb) { nodes.resize(mb); }
+
+size_t MCTS::reroot(const Board &root) {
+	std::vector<NodeEntry*> live;
+	Board b = root;
+	mark_live(b, live);
+	nodes.retain(live);
+	return live.size();
+}
+
+// Depth-first walk over visited edges; the mark doubles as the visited set for transpositions.
+void MCTS::mark_live(Board &b, std::vector<NodeEntry*> &live) {
+	NodeEntry *n = nodes.find(nodes.bucket(b.hash), b.hash);
+	if (!n || (n->flags & NODE_MARK)) return;
+	n->flags |= NODE_MARK;
+	live.push_back(n);
+	for (uint32_t i=0; i<n->num_edges; ++i) {
+		if (nodes.edge_visits(n->edges)[i] == 0) continue;
+		b.make_move(nodes.edge_moves(n->edges)[i]);
+		mark_live(b, live);
+		b.unmake_move();
+	}
+}
+
+Move MCTS::search_best_move(Board &root, int simulations, float c_puct_, int threads) {
+	c_puct = c_puct_;
+	nodes.new_search();
+	auto start = std::chrono::steady_clock::now();
+	const bool timed = time_plan.hard_ms > 0;
+	const int64_t soft_ms = std::min(time_plan.soft_ms > 0 ? time_plan.soft_ms : time_plan.hard_ms, time_plan.hard_ms);
+	const bool managed = timed || (early_stop && simulations > 0);
+	std::atomic<int> started{0};
+	std::atomic<uint64_t> done{0};
+	std::atomic<bool> halt{false};
+	// whichever thread pushes `done` past next_poll checks the limits; it holds off the others
+	// by parking next_poll at the maximum until it has set the next one
+	std::atomic<uint64_t> next_poll{FIRST_POLL};
+	std::atomic<int> last_best{-1};
+	auto poll = [&](uint64_t n) {
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		double rate = n / std::max(us, 1.0); // simulations per microsecond, all threads
+		next_poll.store(n + (uint64_t)std::max(1.0, std::min(4096.0, rate * TIME_POLL_US)), std::memory_order_relaxed);
+		double ms = us / 1000.0;
+		if (timed && ms >= time_plan.hard_ms) return true;
+		double left_soft = std::numeric_limits<double>::infinity(), left_hard = left_soft;
+		if (timed) {
+			left_soft = rate * 1000.0 * std::max(0.0, soft_ms - ms);
+			left_hard = rate * 1000.0 * (time_plan.hard_ms - ms);
+		}
+		if (simulations > 0) {
+			left_soft = std::min(left_soft, (double)simulations - n);
+			left_hard = std::min(left_hard, (double)simulations - n);
+		}
+		RootLeaders r = root_leaders(root);
+		bool settled = r.settled && r.best == last_best.exchange(r.best, std::memory_order_relaxed);
+		if (timed && ms >= soft_ms && settled) return true;
+		if (!early_stop || !r.edges) return false;
+		double lead = r.first - r.second;
+		return r.edges == 1 || lead > left_hard || (settled && lead > left_soft);
+	};
+	auto report = [&]() {
+		SearchInfo info;
+		info.simulations = done.load(std::memory_order_relaxed);
+		info.elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		info.pv = principal_variation(root, 32, &info.q);
+		info_cb(info);
+	};
+	const int k = batch_size;
+	auto worker = [&](bool reporter) {
+		Board b = root; // one working copy per thread; every descent is unwound before the next
+		evaluator->attach(b);
+		std::unique_ptr<LeafBatch> batch = evaluator->new_batch(k);
+		std::vector<std::vector<PathEntry>> paths(k); // the simulations waiting on the batch
+		std::vector<float> vals(k);
+		std::vector<QUpdate> qbuf; // this thread's Q updates, merged once the search is done
+		auto next_info = start + std::chrono::milliseconds(info_interval_ms);
+		while (!(stop_flag && stop_flag->load(std::memory_order_relaxed)) && !halt.load(std::memory_order_relaxed)) {
+			int m = k;
+			if (simulations > 0) {
+				int s = started.fetch_add(k, std::memory_order_relaxed);
+				if (s >= simulations) break;
+				m = std::min(k, simulations - s);
 			}
-			table.emplace(k, nd);
-			float v = playout(b);
-			// backprop
-			for (auto it = path.rbegin(); it != path.rend(); ++it) {
-				MCTSNodeData &n = table[it->first];
-				n.visits++;
-				n.value_sum += v;
-				if (it->second != (size_t)-1) {
-					n.child_visits[it->second]++;
-					n.child_values[it->second] += v;
-				}
-				if (persistent_q) {
-					auto &q = qtable[it->first.hash];
-					q.first += v; // sum
-					q.second += 1; // visits
-				}
-				v = -v; // switch perspective
+			size_t base = b.ply();
+			int pending = 0;
+			for (int i=0; i<m; ++i) {
+				float v;
+				if (descend(b, paths[pending], v)) { batch->add(b); ++pending; }
+				else backprop(paths[pending], v, qbuf); // settled without the evaluator
+				b.unmake_to(base);
 			}
-			return v;
-		}
-		MCTSNodeData &node = tit->second;
-		if (node.moves.empty()) {
-			// terminal
-			GameResult g = b.evaluate_terminal();
-			float v = g.reward;
-			for (auto it = path.rbegin(); it != path.rend(); ++it) {
-				MCTSNodeData &n = table[it->first];
-				n.visits++;
-				n.value_sum += v;
-				if (it->second != (size_t)-1) {
-					n.child_visits[it->second]++;
-					n.child_values[it->second] += v;
+			if (pending) {
+				{
+					STAT_TIMER(TM_EVAL);
+					batch->evaluate(vals.data());
 				}
-				if (persistent_q) {
-					auto &q = qtable[it->first.hash];
-					q.first += v;
-					q.second += 1;
-				}
-				v = -v;
+				// values are for the side to move at the leaf, which the last path node's player moved into
+				for (int i=0; i<pending; ++i) backprop(paths[i], -vals[i], qbuf);
+			}
+			uint64_t n = done.fetch_add(m, std::memory_order_relaxed) + m;
+			STAT_ADD(ST_SIMULATIONS, m);
+			if (qbuf.size() >= Q_FLUSH) flush_q(qbuf);
+			uint64_t np = next_poll.load(std::memory_order_relaxed);
+			if (managed && n >= np && next_poll.compare_exchange_strong(np, std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed) && poll(n))
+				halt.store(true, std::memory_order_relaxed);
+			if (reporter && ((n - m) >> 6) != (n >> 6) && std::chrono::steady_clock::now() >= next_info) {
+				report();
+				next_info += std::chrono::milliseconds(info_interval_ms);
 			}
-			return v;
 		}
-		// select
-		uint32_t parent_vis = std::max(1u, node.visits);
-		float best = -1e9f; size_t best_i = 0;
-		for (size_t i=0;i<node.moves.size();++i) {
-			float sv = ucb_score(parent_vis, node.child_visits[i], node.child_values[i], 1.2f);
-			if (node.child_visits[i] == 0) {
-				sv += 0.001f * (float)GLOBAL_RNG.uniform01();
+		flush_q(qbuf);
+	};
+	std::vector<std::thread> pool;
+	for (int t=1; t<threads; ++t) pool.emplace_back(worker, false);
+	worker((bool)info_cb);
+	for (auto &th : pool) th.join();
+	if (info_cb) report();
+	// pick move with max visits
+	std::vector<Move> pv = principal_variation(root, 1);
+	if (!pv.empty()) return pv[0];
+	MoveList legal;
+	root.generate_legal_moves(legal);
+	if (legal.empty()) return Move{0,0,0,0};
+	return legal[GLOBAL_RNG.below((uint32_t)legal.size())];
+}
+
+MCTS::RootLeaders MCTS::root_leaders(const Board &root) {
+	RootLeaders r;
+	NodeBucket &bk = nodes.bucket(root.hash);
+	bk.lock.lock();
+	if (NodeEntry *node = nodes.find(bk, root.hash)) {
+		const uint32_t *cv = nodes.edge_visits(node->edges);
+		const float *cq = nodes.edge_values(node->edges);
+		r.edges = node->num_edges;
+		for (uint32_t i=0; i<r.edges; ++i) {
+			if (cv[i] > r.first) { r.second = r.first; r.first = cv[i]; r.best = (int)i; }
+			else if (cv[i] > r.second) r.second = cv[i];
+		}
+		r.settled = r.first > 0;
+		for (uint32_t i=0; i<r.edges && r.settled; ++i) {
+			if ((int)i != r.best && cv[i] * 4 >= r.first && cq[i] / cv[i] > cq[r.best] / r.first) r.settled = false;
+		}
+	}
+	bk.lock.unlock();
+	return r;
+}
+
+std::vector<Move> MCTS::principal_variation(const Board &root, size_t max_len, float *root_q, uint32_t *root_visits) {
+	std::vector<Move> pv;
+	if (root_q) *root_q = 0.0f;
+	if (root_visits) *root_visits = 0;
+	Board b = root;
+	while (pv.size() < max_len) {
+		NodeBucket &bk = nodes.bucket(b.hash);
+		bk.lock.lock();
+		NodeEntry *node = nodes.find(bk, b.hash);
+		uint32_t best_v = 0; size_t best_i = 0;
+		Move mv{0,0,0,0};
+		if (node) {
+			const uint32_t *cv = nodes.edge_visits(node->edges);
+			for (size_t i=0;i<node->num_edges;++i) {
+				if (cv[i] > best_v) { best_v = cv[i]; best_i = i; }
+			}
+			if (best_v) {
+				mv = nodes.edge_moves(node->edges)[best_i];
+				if (pv.empty() && root_q) *root_q = nodes.edge_values(node->edges)[best_i] / (float)best_v;
+				if (pv.empty() && root_visits) *root_visits = best_v;
 			}
-			if (sv > best) { best = sv; best_i = i; }
 		}
-		// step
-		Piece cap; uint8_t oc; int8_t oe; uint16_t oh; b.make_move(node.moves[best_i], cap, oc, oe, oh);
-		path.emplace_back(k, best_i);
+		bk.lock.unlock();
+		if (!best_v) break;
+		pv.push_back(mv);
+		b.make_move(mv);
+	}
+	return pv;
+}
+
+void MCTS::root_visits(const Board &root, std::vector<std::pair<Move,uint32_t>> &out) {
+	out.clear();
+	NodeBucket &bk = nodes.bucket(root.hash);
+	bk.lock.lock();
+	if (NodeEntry *node = nodes.find(bk, root.hash)) {
+		for (uint32_t i=0; i<node->num_edges; ++i) out.emplace_back(nodes.edge_moves(node->edges)[i], nodes.edge_visits(node->edges)[i]);
 	}
+	bk.lock.unlock();
 }
 
-float MCTS::playout(Board &b) {
-	// Light playout with epsilon-greedy on material and random noise
-	for (int depth=0; depth<192; ++depth) {
-		GameResult g = b.evaluate_terminal();
-		if (g.terminal) return g.reward;
-		auto moves = b.generate_legal_moves();
-		if (moves.empty()) return 0.0f;
-		// choose move
-		int best_score = std::numeric_limits<int>::min();
-		int best_idx = -1;
-		for (size_t i=0;i<moves.size();++i) {
-			Board nb = b; Piece cap; uint8_t oc; int8_t oe; uint16_t oh; nb.make_move(moves[i], cap, oc, oe, oh);
-			int s = nb.material_eval() * (nb.white_to_move ? -1 : 1);
-			// little randomization to encourage exploration
-			s += (int)((GLOBAL_RNG.uniform01()-0.5)*10);
-			nb.unmake_move(moves[i], cap, oc, oe, oh);
-			if (s > best_score) { best_score = s; best_idx = (int)i; }
+// Edges are filled before the node is published, so other threads only ever see complete
+// nodes. If another thread expanded the same position meanwhile, its node wins and our edges go
+// back to the pool. When the edge pool is exhausted the leaf is still evaluated, just not stored.
+int MCTS::expand(const Board &b) {
+	STAT_TIMER(TM_EXPAND);
+	MoveList legal;
+	b.generate_legal_moves(legal);
+	STAT_ADD(ST_EDGES, legal.size());
+	uint32_t edges = NodeTable::NO_EDGES;
+	if (!legal.empty()) {
+		edges = nodes.alloc_edges((uint32_t)legal.size());
+		if (edges == NodeTable::NO_EDGES) {
+			// a full pool: make room from a node left over from an earlier search, if the
+			// leaf's bucket holds one
+			NodeBucket &bk = nodes.bucket(b.hash);
+			bk.lock.lock();
+			bool freed = nodes.release_stale(bk);
+			bk.lock.unlock();
+			if (freed) edges = nodes.alloc_edges((uint32_t)legal.size());
+			if (edges == NodeTable::NO_EDGES) return (int)legal.size();
 		}
-		if (best_idx < 0) best_idx = (int)(GLOBAL_RNG.uniform01()*moves.size());
-		Piece cap; uint8_t oc; int8_t oe; uint16_t oh; b.make_move(moves[best_idx], cap, oc, oe, oh);
+		// unvisited edges tie and select_ucb takes the lowest index, so the order is the
+		// exploration order: shuffle it rather than trying children in generation order
+		Move *mv = nodes.edge_moves(edges);
+		std::copy(legal.begin(), legal.end(), mv);
+		for (uint32_t i=(uint32_t)legal.size()-1; i>0; --i) std::swap(mv[i], mv[GLOBAL_RNG.below(i+1)]);
+		std::fill_n(nodes.edge_visits(edges), legal.size(), 0u);
+		std::fill_n(nodes.edge_values(edges), legal.size(), 0.0f);
+	}
+	std::pair<float,uint32_t> seed{0.0f, 0};
+	// seed from persistent q if enabled
+	if (persistent_q) {
+		STAT_TIMER(TM_Q_SEED);
+		if (qbase) qbase->add_q_unlocked(b.hash, seed);
+		std::lock_guard<std::mutex> g(qtable_mu);
+		add_q_unlocked(b.hash, seed);
+		// intentionally skip per-child seeding for speed
+	}
+	NodeBucket &bk = nodes.bucket(b.hash);
+	bk.lock.lock();
+	if (!nodes.find(bk, b.hash)) {
+		NodeEntry *nd = nodes.insert(bk, b.hash);
+		nd->value_sum = seed.first;
+		nd->visits = seed.second;
+		nd->edges = edges;
+		nd->num_edges = (uint16_t)legal.size();
 	}
-	return 0.0f;
-}
\ No newline at end of file
+	else if (edges != NodeTable::NO_EDGES) nodes.free_edges(edges, (uint32_t)legal.size()); // lost the race
+	bk.lock.unlock();
+	return (int)legal.size();
+}
+
+// v is the leaf value from the perspective of the player to move at the last path node.
+void MCTS::backprop(const std::vector<PathEntry> &path, float v, std::vector<QUpdate> &qbuf) {
+	float pv = v;
+	for (auto it = path.rbegin(); it != path.rend(); ++it) {
+		it->bucket->lock.lock();
+		NodeEntry &n = *it->node;
+		// skip nodes that were evicted (and possibly reused) after we passed through them
+		if ((n.flags & NODE_USED) && n.key == (uint32_t)(it->hash >> 32) && n.edges == it->edges) {
+			n.visits += 1 - VIRTUAL_LOSS; // replace the virtual visit with the real one
+			n.value_sum += pv;
+			nodes.edge_visits(n.edges)[it->child] += 1 - VIRTUAL_LOSS;
+			nodes.edge_values(n.edges)[it->child] += pv + (float)VIRTUAL_LOSS;
+		}
+		it->bucket->lock.unlock();
+		if (persistent_q) qbuf.push_back(QUpdate{it->hash, pv});
+		pv = -pv; // switch perspective
+	}
+}
+
+// Selects from the root down to the first node not in the table and expands it. Returns true
+// with b at that leaf if it needs the evaluator; otherwise the leaf is settled by the rules or
+// the endgame tables and v holds its value for the player who moved into it. The path keeps
+// its virtual losses until backprop.
+bool MCTS::descend(Board &b, std::vector<PathEntry> &path, float &v) {
+	path.clear();
+	while (true) {
+		uint64_t key = b.hash;
+		// the table is keyed by position, so transpositions can cycle back onto the path
+		bool repeated = false;
+		for (auto &pe : path) if (pe.hash == key) { repeated = true; break; }
+		// below the root, table positions are settled without being expanded
+		int wdl;
+		if (!repeated && !path.empty() && egtb && popcount(b.occupied) <= 4 && egtb->probe(b, wdl)) {
+			STAT_ADD(ST_EGTB_HITS, 1);
+			STAT_DEPTH(path.size());
+			v = (float)-wdl;
+			return false;
+		}
+		NodeBucket &bk = nodes.bucket(key);
+		bk.lock.lock();
+		NodeEntry *node = repeated ? nullptr : nodes.find(bk, key);
+		if (!repeated) {
+			STAT_ADD(node ? ST_TABLE_HIT : ST_TABLE_MISS, 1);
+			STAT_ADD(ST_TABLE_COLLISIONS, nodes.other_keys(bk, key));
+		}
+		if (!node && !repeated) {
+			bk.lock.unlock();
+			STAT_DEPTH(path.size());
+			int legal = expand(b);
+			// the same rule checks a playout makes at its first ply
+			if (legal == 0) { v = b.in_check(b.white_to_move) ? 1.0f : 0.0f; return false; }
+			if (b.halfmove_clock >= 100 || b.is_repetition(1) || b.insufficient_material()) { v = 0.0f; return false; }
+			return true;
+		}
+		if (repeated || node->num_edges == 0) {
+			bk.lock.unlock();
+			STAT_DEPTH(path.size());
+			// terminal (a repetition on the selection path is scored as a draw)
+			GameResult g = repeated ? GameResult{0.0f,true} : b.evaluate_terminal();
+			v = b.white_to_move ? -g.reward : g.reward;
+			return false;
+		}
+		// select, then add a virtual loss so concurrent threads spread over other children
+		uint32_t *cv = nodes.edge_visits(node->edges);
+		float *cq = nodes.edge_values(node->edges);
+		size_t best_i = select_ucb(cv, cq, node->num_edges, c_puct * std::sqrt((float)std::max(1u, node->visits)));
+		node->visits += VIRTUAL_LOSS;
+		cv[best_i] += VIRTUAL_LOSS;
+		cq[best_i] -= (float)VIRTUAL_LOSS;
+		node->age = nodes.generation();
+		Move mv = nodes.edge_moves(node->edges)[best_i];
+		path.push_back(PathEntry{key, &bk, node, node->edges, (uint32_t)best_i});
+		bk.lock.unlock();
+		// step
+		b.make_move(mv);
+	}
+}
+
+float MCTS::run_playout(Board &b) {
+	size_t base = b.ply();
+	float r = playouts.playout(b);
+	STAT_ADD(ST_PLAYOUT_PLIES, b.ply() - base);
+	b.unmake_to(base);
+	return r;
+}
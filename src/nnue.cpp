@@ -0,0 +1,206 @@
+#include "nnue.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static const char NNUE_MAGIC[8] = {'C','R','L','N','N','U','E','\0'};
+
+Nnue::Nnue() : w1((size_t)NNUE_FEATURES * NNUE_HIDDEN, 0), b1(NNUE_HIDDEN, 0), w2((size_t)NNUE_L2 * NNUE_INPUTS, 0), b2(NNUE_L2, 0), w3(NNUE_L2, 0), b3(0) {}
+
+template <typename T>
+static bool read_array(FILE *f, std::vector<T> &v) { return std::fread(v.data(), sizeof(T), v.size(), f) == v.size(); }
+template <typename T>
+static bool write_array(FILE *f, const std::vector<T> &v) { return std::fwrite(v.data(), sizeof(T), v.size(), f) == v.size(); }
+
+bool Nnue::load(const std::string &path) {
+	FILE *f = std::fopen(path.c_str(), "rb");
+	if (!f) return false;
+	NnueFileHeader h;
+	Nnue n;
+	bool ok = std::fread(&h, sizeof(h), 1, f) == 1 && std::memcmp(h.magic, NNUE_MAGIC, 8) == 0 && h.version == NNUE_VERSION
+		&& h.features == NNUE_FEATURES && h.hidden == NNUE_HIDDEN && h.l2 == NNUE_L2
+		&& read_array(f, n.w1) && read_array(f, n.b1) && read_array(f, n.w2) && read_array(f, n.b2) && read_array(f, n.w3)
+		&& std::fread(&n.b3, sizeof(n.b3), 1, f) == 1 && std::fgetc(f) == EOF;
+	std::fclose(f);
+	if (ok) *this = n;
+	return ok;
+}
+
+bool Nnue::save(const std::string &path) const {
+	NnueFileHeader h;
+	std::memcpy(h.magic, NNUE_MAGIC, 8);
+	h.version = NNUE_VERSION;
+	h.features = NNUE_FEATURES;
+	h.hidden = NNUE_HIDDEN;
+	h.l2 = NNUE_L2;
+	FILE *f = std::fopen(path.c_str(), "wb");
+	if (!f) return false;
+	bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 && write_array(f, w1) && write_array(f, b1) && write_array(f, w2)
+		&& write_array(f, b2) && write_array(f, w3) && std::fwrite(&b3, sizeof(b3), 1, f) == 1;
+	return std::fclose(f) == 0 && ok;
+}
+
+// out = in + sum of add rows - sum of sub rows, over one perspective's NNUE_HIDDEN lanes.
+static void apply_rows(int16_t *out, const int16_t *in, const int16_t *const *add, int na, const int16_t *const *sub, int ns) {
+#if defined(__AVX2__)
+	for (int i=0; i<NNUE_HIDDEN; i+=16) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+		for (int k=0; k<na; ++k) v = _mm256_add_epi16(v, _mm256_loadu_si256((const __m256i*)(add[k] + i)));
+		for (int k=0; k<ns; ++k) v = _mm256_sub_epi16(v, _mm256_loadu_si256((const __m256i*)(sub[k] + i)));
+		_mm256_storeu_si256((__m256i*)(out + i), v);
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	for (int i=0; i<NNUE_HIDDEN; i+=8) {
+		int16x8_t v = vld1q_s16(in + i);
+		for (int k=0; k<na; ++k) v = vaddq_s16(v, vld1q_s16(add[k] + i));
+		for (int k=0; k<ns; ++k) v = vsubq_s16(v, vld1q_s16(sub[k] + i));
+		vst1q_s16(out + i, v);
+	}
+#else
+	// row by row keeps the inner loops simple enough for the compiler to vectorise
+	if (out != in) std::copy(in, in + NNUE_HIDDEN, out);
+	for (int k=0; k<na; ++k) for (int i=0; i<NNUE_HIDDEN; ++i) out[i] = (int16_t)(out[i] + add[k][i]);
+	for (int k=0; k<ns; ++k) for (int i=0; i<NNUE_HIDDEN; ++i) out[i] = (int16_t)(out[i] - sub[k][i]);
+#endif
+}
+
+// Clipped ReLU: int16 lanes to [0, 127] bytes.
+static void clip_relu(const int16_t *in, uint8_t *out) {
+#if defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256();
+	for (int i=0; i<NNUE_HIDDEN; i+=32) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(in + i)), b = _mm256_loadu_si256((const __m256i*)(in + i + 16));
+		// packs works per 128-bit lane; the permute restores element order
+		__m256i p = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_max_epi8(p, zero));
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	const int8x16_t zero = vdupq_n_s8(0);
+	for (int i=0; i<NNUE_HIDDEN; i+=16) {
+		int8x16_t p = vcombine_s8(vqmovn_s16(vld1q_s16(in + i)), vqmovn_s16(vld1q_s16(in + i + 8)));
+		vst1q_u8(out + i, vreinterpretq_u8_s8(vmaxq_s8(p, zero)));
+	}
+#else
+	for (int i=0; i<NNUE_HIDDEN; ++i) out[i] = (uint8_t)std::max(0, std::min(127, (int)in[i]));
+#endif
+}
+
+// Dot product of NNUE_INPUTS activations in [0, 127] with one int8 weight row.
+static int32_t dot_row(const uint8_t *x, const int8_t *w) {
+#if defined(__AVX2__)
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum = _mm256_setzero_si256();
+	for (int i=0; i<NNUE_INPUTS; i+=32) {
+		// pairs of u8*i8 products add to at most 2*127*127, so maddubs cannot saturate
+		__m256i p = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(x + i)), _mm256_loadu_si256((const __m256i*)(w + i)));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(p, ones));
+	}
+	__m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+	return _mm_cvtsi128_si32(s);
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	int32x4_t sum = vdupq_n_s32(0);
+	for (int i=0; i<NNUE_INPUTS; i+=16) {
+		int8x16_t xv = vreinterpretq_s8_u8(vld1q_u8(x + i)), wv = vld1q_s8(w + i);
+		int16x8_t p = vmull_s8(vget_low_s8(xv), vget_low_s8(wv));
+		p = vmlal_high_s8(p, xv, wv); // same 2*127*127 bound as above
+		sum = vpadalq_s16(sum, p);
+	}
+	return vaddvq_s32(sum);
+#else
+	int32_t s = 0;
+	for (int i=0; i<NNUE_INPUTS; ++i) s += (int16_t)x[i] * (int16_t)w[i];
+	return s;
+#endif
+}
+
+static float eval_acc(const Nnue &net, const NnueAccumulator &acc, int us) {
+	alignas(32) uint8_t x[NNUE_INPUTS];
+	clip_relu(acc.v[us], x);
+	clip_relu(acc.v[us ^ 1], x + NNUE_HIDDEN);
+	int32_t out = net.b3;
+	for (int j=0; j<NNUE_L2; ++j) {
+		int32_t s = net.b2[j] + dot_row(x, net.w2.data() + j * NNUE_INPUTS);
+		out += std::max(0, std::min(127, s / 64)) * net.w3[j];
+	}
+	return std::tanh((float)out / NNUE_OUT_SCALE);
+}
+
+float Nnue::evaluate(const Board &b) const { return eval_acc(*this, b.nnue_acc.back(), b.white_to_move ? 0 : 1); }
+
+// Layer 2 row by row across up to NNUE_CHUNK positions, so each weight row is loaded once per
+// chunk instead of once per position.
+static constexpr size_t NNUE_CHUNK = 16;
+
+void Nnue::evaluate_batch(const NnueAccumulator *acc, const uint8_t *us, size_t n, float *out) const {
+	alignas(32) uint8_t x[NNUE_CHUNK][NNUE_INPUTS];
+	int32_t o[NNUE_CHUNK];
+	for (size_t c=0; c<n; c+=NNUE_CHUNK) {
+		size_t m = std::min(NNUE_CHUNK, n - c);
+		for (size_t i=0; i<m; ++i) {
+			clip_relu(acc[c + i].v[us[c + i]], x[i]);
+			clip_relu(acc[c + i].v[us[c + i] ^ 1], x[i] + NNUE_HIDDEN);
+			o[i] = b3;
+		}
+		for (int j=0; j<NNUE_L2; ++j) {
+			const int8_t *row = w2.data() + j * NNUE_INPUTS;
+			for (size_t i=0; i<m; ++i) o[i] += std::max(0, std::min(127, (b2[j] + dot_row(x[i], row)) / 64)) * w3[j];
+		}
+		for (size_t i=0; i<m; ++i) out[c + i] = std::tanh((float)o[i] / NNUE_OUT_SCALE);
+	}
+}
+
+void Nnue::refresh(const Board &b, NnueAccumulator &acc) const {
+	for (int p=0; p<2; ++p) {
+		std::copy(b1.begin(), b1.end(), acc.v[p]);
+		const int16_t *rows[16];
+		int n = 0;
+		for (uint64_t occ = b.occupied; occ; ) {
+			int sq = pop_lsb(occ);
+			rows[n++] = w1.data() + feature(p, b.squares[sq], sq) * NNUE_HIDDEN;
+			if (n == 16) { apply_rows(acc.v[p], acc.v[p], rows, n, nullptr, 0); n = 0; }
+		}
+		apply_rows(acc.v[p], acc.v[p], rows, n, nullptr, 0);
+	}
+}
+
+void Nnue::update(const Board &b, const Move &m, const NnueAccumulator &in, NnueAccumulator &out) const {
+	struct PieceSq { Piece p; int sq; } adds[2], subs[3];
+	int na = 0, ns = 0;
+	const Piece moving = b.squares[m.from];
+	subs[ns++] = {moving, m.from};
+	adds[na++] = {(m.flags & 4) ? (Piece)m.promotion : moving, m.to};
+	if (m.flags & 2) subs[ns++] = {is_white(moving) ? BP : WP, m.to + (is_white(moving) ? -8 : 8)};
+	else if (b.squares[m.to] != EMPTY) subs[ns++] = {b.squares[m.to], m.to};
+	if ((m.flags & 1) && abs_piece(moving) == 6 && (file_of(m.to) == 6 || file_of(m.to) == 2)) {
+		int r = rank_of(m.from), kingside = file_of(m.to) == 6;
+		Piece rook = is_white(moving) ? WR : BR;
+		subs[ns++] = {rook, idx(r, kingside ? 7 : 0)};
+		adds[na++] = {rook, idx(r, kingside ? 5 : 3)};
+	}
+	for (int p=0; p<2; ++p) {
+		const int16_t *add[2], *sub[3];
+		for (int k=0; k<na; ++k) add[k] = w1.data() + feature(p, adds[k].p, adds[k].sq) * NNUE_HIDDEN;
+		for (int k=0; k<ns; ++k) sub[k] = w1.data() + feature(p, subs[k].p, subs[k].sq) * NNUE_HIDDEN;
+		apply_rows(out.v[p], in.v[p], add, na, sub, ns);
+	}
+}
+
+void Board::attach_nnue(const Nnue *net) {
+	nnue = net;
+	nnue_acc.clear();
+	if (!net) return;
+	nnue_acc.emplace_back();
+	net->refresh(*this, nnue_acc.back());
+}
+
+void Board::nnue_push(const Move &m) {
+	nnue_acc.emplace_back();
+	nnue->update(*this, m, nnue_acc[nnue_acc.size() - 2], nnue_acc.back());
+}
@@ -0,0 +1,187 @@
+#include "nnue.hpp"
+#include "trainfile.hpp"
+#include <algorithm>
+
+// Training runs in float on a flat parameter vector with the same layout as the file.
+namespace {
+
+constexpr size_t P_W1 = 0, P_B1 = P_W1 + (size_t)NNUE_FEATURES * NNUE_HIDDEN, P_W2 = P_B1 + NNUE_HIDDEN;
+constexpr size_t P_B2 = P_W2 + (size_t)NNUE_L2 * NNUE_INPUTS, P_W3 = P_B2 + NNUE_L2, P_B3 = P_W3 + NNUE_L2, P_COUNT = P_B3 + 1;
+constexpr float W1_LIMIT = 4.0f; // keeps 32 pieces plus bias inside int16 after scaling by 127
+constexpr float W8_LIMIT = 127.0f / 64.0f; // int8 weights at scale 64
+
+struct Sample {
+	uint16_t feat[2][32];
+	uint8_t pieces;
+	uint8_t us; // perspective of the side to move
+	float target; // final result for the side to move
+};
+
+struct Activations {
+	float acc[2][NNUE_HIDDEN];
+	float x[NNUE_INPUTS];
+	float l2[NNUE_L2];
+	float h2[NNUE_L2];
+	float value;
+};
+
+void forward(const std::vector<float> &p, const Sample &s, Activations &a) {
+	for (int q=0; q<2; ++q) {
+		std::copy(&p[P_B1], &p[P_B1] + NNUE_HIDDEN, a.acc[q]);
+		for (int k=0; k<s.pieces; ++k) {
+			const float *row = &p[P_W1 + (size_t)s.feat[q][k] * NNUE_HIDDEN];
+			for (int i=0; i<NNUE_HIDDEN; ++i) a.acc[q][i] += row[i];
+		}
+	}
+	for (int i=0; i<NNUE_HIDDEN; ++i) {
+		a.x[i] = std::max(0.0f, std::min(1.0f, a.acc[s.us][i]));
+		a.x[NNUE_HIDDEN + i] = std::max(0.0f, std::min(1.0f, a.acc[s.us ^ 1][i]));
+	}
+	float out = p[P_B3];
+	for (int j=0; j<NNUE_L2; ++j) {
+		float v = p[P_B2 + j];
+		const float *w = &p[P_W2 + (size_t)j * NNUE_INPUTS];
+		for (int i=0; i<NNUE_INPUTS; ++i) v += w[i] * a.x[i];
+		a.l2[j] = v;
+		a.h2[j] = std::max(0.0f, std::min(1.0f, v));
+		out += p[P_W3 + j] * a.h2[j];
+	}
+	a.value = std::tanh(out);
+}
+
+// Adds the gradient of (value - target)^2 to g; returns the squared error.
+float backward(const std::vector<float> &p, const Sample &s, std::vector<float> &g) {
+	Activations a;
+	forward(p, s, a);
+	float err = a.value - s.target;
+	float d_out = 2.0f * err * (1.0f - a.value * a.value);
+	g[P_B3] += d_out;
+	float d_x[NNUE_INPUTS] = {};
+	for (int j=0; j<NNUE_L2; ++j) {
+		g[P_W3 + j] += d_out * a.h2[j];
+		float d_l2 = a.l2[j] > 0.0f && a.l2[j] < 1.0f ? d_out * p[P_W3 + j] : 0.0f;
+		if (d_l2 == 0.0f) continue;
+		g[P_B2 + j] += d_l2;
+		float *gw = &g[P_W2 + (size_t)j * NNUE_INPUTS];
+		const float *w = &p[P_W2 + (size_t)j * NNUE_INPUTS];
+		for (int i=0; i<NNUE_INPUTS; ++i) { gw[i] += d_l2 * a.x[i]; d_x[i] += d_l2 * w[i]; }
+	}
+	for (int q=0; q<2; ++q) {
+		const float *dx = d_x + (q == s.us ? 0 : NNUE_HIDDEN);
+		float d_acc[NNUE_HIDDEN];
+		for (int i=0; i<NNUE_HIDDEN; ++i) {
+			d_acc[i] = a.acc[q][i] > 0.0f && a.acc[q][i] < 1.0f ? dx[i] : 0.0f;
+			g[P_B1 + i] += d_acc[i];
+		}
+		for (int k=0; k<s.pieces; ++k) {
+			float *gw = &g[P_W1 + (size_t)s.feat[q][k] * NNUE_HIDDEN];
+			for (int i=0; i<NNUE_HIDDEN; ++i) gw[i] += d_acc[i];
+		}
+	}
+	return err * err;
+}
+
+float mean_error(const std::vector<float> &p, const std::vector<Sample> &data, size_t begin, size_t end) {
+	double sum = 0;
+	Activations a;
+	for (size_t i=begin; i<end; ++i) {
+		forward(p, data[i], a);
+		sum += (a.value - data[i].target) * (a.value - data[i].target);
+	}
+	return end > begin ? (float)(sum / (double)(end - begin)) : 0.0f;
+}
+
+template <typename T>
+T quantize(float v, float scale, float lo, float hi) { return (T)std::lround(std::max(lo, std::min(hi, v * scale))); }
+
+} // namespace
+
+bool train_nnue(const std::string &data_path, const NnueTrainOptions &opt, Nnue &net, std::ostream &log) {
+	TrainReader reader;
+	if (!reader.open(data_path)) return false;
+	std::vector<Sample> data;
+	TrainSample ts;
+	while (reader.next(ts)) {
+		const Board &b = ts.board;
+		if (popcount(b.occupied) > 32) continue;
+		Sample s;
+		s.pieces = 0;
+		for (uint64_t occ = b.occupied; occ; ) {
+			int sq = pop_lsb(occ);
+			for (int q=0; q<2; ++q) s.feat[q][s.pieces] = (uint16_t)Nnue::feature(q, b.squares[sq], sq);
+			++s.pieces;
+		}
+		s.us = b.white_to_move ? 0 : 1;
+		s.target = b.white_to_move ? ts.result : -ts.result;
+		data.push_back(s);
+	}
+	if (reader.corrupt()) log << data_path << ": corrupt record at byte " << reader.offset() << ", training on the " << data.size() << " records before it\n";
+	if (data.empty()) return false;
+
+	RNG rng(opt.seed);
+	for (size_t i=data.size()-1; i>0; --i) std::swap(data[i], data[rng.below((uint32_t)(i + 1))]);
+	const size_t held = std::min(data.size() - 1, (size_t)(data.size() * opt.validation));
+	const size_t train_end = data.size() - held;
+
+	std::vector<float> p(P_COUNT);
+	auto uniform = [&](float r) { return (rng.uniform01f() * 2.0f - 1.0f) * r; };
+	for (size_t i=P_W1; i<P_B1; ++i) p[i] = uniform(0.05f);
+	for (size_t i=P_B1; i<P_W2; ++i) p[i] = 0.25f;
+	for (size_t i=P_W2; i<P_B2; ++i) p[i] = uniform(0.1f);
+	for (size_t i=P_W3; i<P_B3; ++i) p[i] = uniform(0.3f);
+
+	std::vector<float> g(P_COUNT), m1(P_COUNT), m2(P_COUNT);
+	const float beta1 = 0.9f, beta2 = 0.999f;
+	float pow1 = 1.0f, pow2 = 1.0f;
+	const int batch = std::max(1, opt.batch);
+	log << data.size() << " positions, " << held << " held out\n";
+	for (int epoch=1; epoch<=opt.epochs; ++epoch) {
+		for (size_t i=train_end-1; i>0; --i) std::swap(data[i], data[rng.below((uint32_t)(i + 1))]);
+		double loss = 0;
+		for (size_t start=0; start<train_end; start+=batch) {
+			size_t end = std::min(train_end, start + (size_t)batch);
+			std::fill(g.begin(), g.end(), 0.0f);
+			for (size_t i=start; i<end; ++i) loss += backward(p, data[i], g);
+			// Adam, then clip into what the quantized layers can represent
+			pow1 *= beta1; pow2 *= beta2;
+			const float step = opt.lr * std::sqrt(1.0f - pow2) / (1.0f - pow1), inv = 1.0f / (float)(end - start);
+			for (size_t k=0; k<P_COUNT; ++k) {
+				float gk = g[k] * inv;
+				m1[k] = beta1 * m1[k] + (1.0f - beta1) * gk;
+				m2[k] = beta2 * m2[k] + (1.0f - beta2) * gk * gk;
+				p[k] -= step * m1[k] / (std::sqrt(m2[k]) + 1e-8f);
+			}
+			for (size_t k=P_W1; k<P_W2; ++k) p[k] = std::max(-W1_LIMIT, std::min(W1_LIMIT, p[k]));
+			for (size_t k=P_W2; k<P_B2; ++k) p[k] = std::max(-W8_LIMIT, std::min(W8_LIMIT, p[k]));
+			for (size_t k=P_W3; k<P_B3; ++k) p[k] = std::max(-W8_LIMIT, std::min(W8_LIMIT, p[k]));
+		}
+		log << "epoch " << epoch << " train mse " << loss / (double)train_end << " validation mse " << mean_error(p, data, train_end, data.size()) << '\n';
+	}
+
+	for (size_t i=0; i<net.w1.size(); ++i) net.w1[i] = quantize<int16_t>(p[P_W1 + i], 127.0f, -32767.0f, 32767.0f);
+	for (int i=0; i<NNUE_HIDDEN; ++i) net.b1[i] = quantize<int16_t>(p[P_B1 + i], 127.0f, -32767.0f, 32767.0f);
+	for (size_t i=0; i<net.w2.size(); ++i) net.w2[i] = quantize<int8_t>(p[P_W2 + i], 64.0f, -127.0f, 127.0f);
+	for (int j=0; j<NNUE_L2; ++j) {
+		net.b2[j] = quantize<int32_t>(p[P_B2 + j], NNUE_OUT_SCALE, -1e9f, 1e9f);
+		net.w3[j] = quantize<int8_t>(p[P_W3 + j], 64.0f, -127.0f, 127.0f);
+	}
+	net.b3 = quantize<int32_t>(p[P_B3], NNUE_OUT_SCALE, -1e9f, 1e9f);
+	// the same held-out positions through the integer path show what quantization cost
+	double qsum = 0;
+	for (size_t i=train_end; i<data.size(); ++i) {
+		const Sample &s = data[i];
+		NnueAccumulator acc;
+		for (int q=0; q<2; ++q) {
+			std::copy(net.b1.begin(), net.b1.end(), acc.v[q]);
+			for (int k=0; k<s.pieces; ++k) {
+				const int16_t *row = net.w1.data() + s.feat[q][k] * NNUE_HIDDEN;
+				for (int j=0; j<NNUE_HIDDEN; ++j) acc.v[q][j] = (int16_t)(acc.v[q][j] + row[j]);
+			}
+		}
+		float v;
+		net.evaluate_batch(&acc, &s.us, 1, &v);
+		qsum += (v - s.target) * (v - s.target);
+	}
+	log << "quantized validation mse " << (held ? qsum / (double)held : 0.0) << '\n';
+	return true;
+}
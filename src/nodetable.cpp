@@ -0,0 +1,162 @@
+#include "nodetable.hpp"
+#include "stats.hpp"
+#include <algorithm>
+
+NodeTable::NodeTable(size_t mb) : bucket_mask(0), edge_capacity(0), edges_used(0), edges_free(0), gen(0) { resize(mb); }
+
+void NodeTable::resize(size_t mb) {
+	size_t bytes = std::max<size_t>(mb, 1) << 20;
+	// node stats take ~1/8 of the budget (a power of two of buckets), edges the rest
+	size_t nb = 1;
+	while (nb * 2 * sizeof(NodeBucket) <= bytes / 8) nb *= 2;
+	buckets.reset(new NodeBucket[nb]);
+	bucket_mask = nb - 1;
+	size_t ne = (bytes - nb * sizeof(NodeBucket)) / (sizeof(Move) + sizeof(uint32_t) + sizeof(float));
+	edge_capacity = (uint32_t)std::min<size_t>(ne, NO_EDGES - 1);
+	moves.reset(new Move[edge_capacity]);
+	visits.reset(new uint32_t[edge_capacity]);
+	values.reset(new float[edge_capacity]);
+	clear();
+}
+
+void NodeTable::clear() {
+	for (size_t i=0; i<=bucket_mask; ++i) {
+		for (auto &e : buckets[i].entries) e = NodeEntry{};
+	}
+	edges_used.store(0, std::memory_order_relaxed);
+	reset_free();
+	gen = 0;
+}
+
+void NodeTable::reset_free() {
+	std::fill_n(free_head, MAX_MOVES + 1, NO_EDGES);
+	edges_free.store(0, std::memory_order_relaxed);
+}
+
+void NodeTable::new_search() {
+	// free lists only serve blocks of a size that was freed or a larger one, so flush while
+	// some slack is left
+	uint32_t free = edges_free.load(std::memory_order_relaxed); // before the bump pointer, so live >= 0
+	uint32_t live = edges_used.load(std::memory_order_relaxed) - free;
+	if (live > edge_capacity / 8 * 7) clear();
+	++gen;
+}
+
+void NodeTable::retain(std::vector<NodeEntry*> &live) {
+	for (size_t i=0; i<=bucket_mask; ++i) {
+		for (auto &e : buckets[i].entries) {
+			if ((e.flags & NODE_USED) && !(e.flags & NODE_MARK)) e = NodeEntry{};
+		}
+	}
+	// compact in ascending pool order so every block only ever moves towards the front
+	std::sort(live.begin(), live.end(), [](const NodeEntry *a, const NodeEntry *b) { return a->edges < b->edges; });
+	uint32_t w = 0;
+	for (NodeEntry *e : live) {
+		e->flags &= ~NODE_MARK;
+		e->age = gen;
+		if (e->num_edges == 0) continue; // terminal, owns no edges
+		if (e->edges != w) {
+			std::copy(edge_moves(e->edges), edge_moves(e->edges) + e->num_edges, edge_moves(w));
+			std::copy(edge_visits(e->edges), edge_visits(e->edges) + e->num_edges, edge_visits(w));
+			std::copy(edge_values(e->edges), edge_values(e->edges) + e->num_edges, edge_values(w));
+			e->edges = w;
+		}
+		w += e->num_edges;
+	}
+	edges_used.store(w, std::memory_order_relaxed);
+	reset_free(); // compaction left no holes
+}
+
+NodeEntry *NodeTable::find(NodeBucket &b, uint64_t hash) const {
+	uint32_t key = (uint32_t)(hash >> 32);
+	for (auto &e : b.entries) {
+		if ((e.flags & NODE_USED) && e.key == key) return &e;
+	}
+	return nullptr;
+}
+
+int NodeTable::other_keys(const NodeBucket &b, uint64_t hash) const {
+	uint32_t key = (uint32_t)(hash >> 32);
+	int n = 0;
+	for (auto &e : b.entries) n += (e.flags & NODE_USED) && e.key != key;
+	return n;
+}
+
+NodeEntry *NodeTable::insert(NodeBucket &b, uint64_t hash) {
+	NodeEntry *victim = nullptr;
+	for (auto &e : b.entries) {
+		if (!(e.flags & NODE_USED)) { victim = &e; break; }
+		bool stale = e.age != gen;
+		if (!victim) { victim = &e; continue; }
+		bool victim_stale = victim->age != gen;
+		if (stale != victim_stale ? stale : e.visits < victim->visits) victim = &e;
+	}
+	STAT_ADD(ST_TABLE_EVICT, victim->flags & NODE_USED);
+	if ((victim->flags & NODE_USED) && victim->edges != NO_EDGES && victim->num_edges) free_edges(victim->edges, victim->num_edges);
+	*victim = NodeEntry{};
+	victim->key = (uint32_t)(hash >> 32);
+	victim->edges = NO_EDGES;
+	victim->age = gen;
+	victim->flags = NODE_USED;
+	return victim;
+}
+
+bool NodeTable::release_stale(NodeBucket &b) {
+	NodeEntry *victim = nullptr;
+	for (auto &e : b.entries) {
+		if (!(e.flags & NODE_USED) || e.age == gen || e.edges == NO_EDGES || !e.num_edges) continue;
+		if (!victim || e.num_edges > victim->num_edges) victim = &e;
+	}
+	if (!victim) return false;
+	STAT_ADD(ST_TABLE_EVICT, 1);
+	free_edges(victim->edges, victim->num_edges);
+	*victim = NodeEntry{};
+	return true;
+}
+
+uint32_t NodeTable::alloc_edges(uint32_t n) {
+	if (edges_free.load(std::memory_order_relaxed) >= n) {
+		uint32_t e = reuse_edges(n);
+		if (e != NO_EDGES) return e;
+	}
+	// the bump pointer only moves when the whole block fits, so it never passes the capacity
+	uint32_t e = edges_used.load(std::memory_order_relaxed);
+	do {
+		if (e > edge_capacity - n) return NO_EDGES;
+	} while (!edges_used.compare_exchange_weak(e, e + n, std::memory_order_relaxed));
+	return e;
+}
+
+// Takes a free block of exactly n edges, or splits the smallest larger one and keeps its tail
+// on the free list of the remaining size.
+uint32_t NodeTable::reuse_edges(uint32_t n) {
+	free_lock.lock();
+	uint32_t e = NO_EDGES;
+	for (uint32_t m = n; m <= (uint32_t)MAX_MOVES; ++m) {
+		if (free_head[m] == NO_EDGES) continue;
+		e = free_head[m];
+		free_head[m] = visits[e];
+		if (m > n) {
+			visits[e + n] = free_head[m - n];
+			free_head[m - n] = e + n;
+		}
+		edges_free.fetch_sub(n, std::memory_order_relaxed);
+		break;
+	}
+	free_lock.unlock();
+	return e;
+}
+
+void NodeTable::free_edges(uint32_t e, uint32_t n) {
+	free_lock.lock();
+	visits[e] = free_head[n];
+	free_head[n] = e;
+	edges_free.fetch_add(n, std::memory_order_relaxed);
+	free_lock.unlock();
+}
+
+int NodeTable::hashfull() const {
+	uint32_t free = edges_free.load(std::memory_order_relaxed); // before the bump pointer, so used >= 0
+	uint64_t used = edges_used.load(std::memory_order_relaxed) - free;
+	return (int)(used * 1000 / std::max<uint32_t>(edge_capacity, 1));
+}
@@ -0,0 +1,146 @@
+#include "perft.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+// Lockless subtree-count cache: the stored key is hash ^ data, so a torn write from
+// another thread simply fails verification instead of returning a wrong count.
+class PerftTable {
+public:
+	explicit PerftTable(size_t mb) {
+		size_t n = 1;
+		while (n * 2 * sizeof(Entry) <= mb * 1024 * 1024) n *= 2;
+		entries.reset(new Entry[n]);
+		mask = n - 1;
+	}
+	bool probe(uint64_t hash, int depth, uint64_t &count) const {
+		const Entry &e = entries[slot(hash, depth)];
+		uint64_t k = e.key.load(std::memory_order_relaxed), d = e.data.load(std::memory_order_relaxed);
+		if ((k ^ d) != hash || (int)(d & 0xFF) != depth) return false;
+		count = d >> 8;
+		return true;
+	}
+	void store(uint64_t hash, int depth, uint64_t count) {
+		Entry &e = entries[slot(hash, depth)];
+		uint64_t d = (count << 8) | (uint64_t)depth;
+		e.key.store(hash ^ d, std::memory_order_relaxed);
+		e.data.store(d, std::memory_order_relaxed);
+	}
+
+private:
+	struct Entry { std::atomic<uint64_t> key{0}, data{0}; };
+	std::unique_ptr<Entry[]> entries;
+	size_t mask;
+
+	size_t slot(uint64_t hash, int depth) const { return (size_t)(hash ^ ((uint64_t)depth * 0x9E3779B97F4A7C15ull)) & mask; }
+};
+
+static uint64_t perft_rec(Board &b, int depth, PerftTable *tt) {
+	if (depth == 0) return 1;
+	uint64_t n = 0;
+	if (tt && depth >= 2 && tt->probe(b.hash, depth, n)) return n;
+	MoveList moves;
+	b.generate_legal_moves(moves);
+	if (depth == 1) return moves.size();
+	for (const Move &m : moves) {
+		b.make_move(m);
+		n += perft_rec(b, depth - 1, tt);
+		b.unmake_move();
+	}
+	if (tt) tt->store(b.hash, depth, n);
+	return n;
+}
+
+uint64_t perft(Board &b, int depth) { return perft_rec(b, depth, nullptr); }
+
+PerftResult run_perft(const Board &root, int depth, const PerftOptions &opt, std::ostream &out) {
+	auto start = std::chrono::steady_clock::now();
+	std::unique_ptr<PerftTable> tt(opt.hash_mb ? new PerftTable(opt.hash_mb) : nullptr);
+	MoveList moves;
+	root.generate_legal_moves(moves);
+	std::vector<uint64_t> counts(moves.size(), 0);
+	uint64_t total = 0;
+	if (depth <= 1) {
+		for (auto &c : counts) c = 1;
+		total = depth == 1 ? moves.size() : 1;
+	} else {
+		std::atomic<size_t> next{0};
+		auto worker = [&]() {
+			Board b = root;
+			for (size_t i; (i = next.fetch_add(1)) < moves.size(); ) {
+				b.make_move(moves[i]);
+				counts[i] = perft_rec(b, depth - 1, tt.get());
+				b.unmake_move();
+			}
+		};
+		int threads = std::max(1, std::min(opt.threads, (int)moves.size()));
+		std::vector<std::thread> pool;
+		for (int t=1; t<threads; ++t) pool.emplace_back(worker);
+		worker();
+		for (auto &th : pool) th.join();
+		for (auto c : counts) total += c;
+	}
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (opt.divide) {
+		for (size_t i=0; i<moves.size(); ++i) out << move_to_uci(moves[i]) << ": " << counts[i] << '\n';
+	}
+	out << "Nodes: " << total << "\nTime: " << secs << " s\nNPS: " << (uint64_t)(total / std::max(secs, 1e-9)) << '\n';
+	return {total, secs};
+}
+
+struct PerftCase {
+	const char *name;
+	const char *fen;
+	int depth;
+	uint64_t nodes;
+};
+
+// Reference counts from the chessprogramming wiki and Martin Sedlak's edge-case suite.
+static const PerftCase PERFT_SUITE[] = {
+	{"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+	{"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+	{"position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+	{"position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+	{"position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487},
+	{"position6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+	{"illegal ep 1", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+	{"illegal ep 2", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+	{"ep gives check", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+	{"short castle check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+	{"long castle check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+	{"castle rights", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+	{"castle prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+	{"promote out of check", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+	{"discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+	{"promote to check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+	{"underpromote to check", "8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+	{"self stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+	{"stalemate/checkmate 1", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+	{"stalemate/checkmate 2", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527},
+};
+
+bool run_perft_suite(const PerftOptions &opt, std::ostream &out, int depth_cap) {
+	PerftOptions quiet = opt;
+	quiet.divide = false;
+	std::ostringstream sink; // per-case totals are reported in the summary line instead
+	bool all_ok = true;
+	uint64_t total_nodes = 0;
+	double total_secs = 0;
+	for (const PerftCase &c : PERFT_SUITE) {
+		if (depth_cap > 0 && c.depth > depth_cap) continue;
+		Board b;
+		if (!b.set_fen(c.fen)) { out << "FAIL " << c.name << ": bad FEN\n"; all_ok = false; continue; }
+		PerftResult r = run_perft(b, c.depth, quiet, sink);
+		bool ok = r.nodes == c.nodes;
+		all_ok &= ok;
+		total_nodes += r.nodes;
+		total_secs += r.seconds;
+		out << (ok ? "ok   " : "FAIL ") << c.name << " depth " << c.depth << ": " << r.nodes;
+		if (!ok) out << " (expected " << c.nodes << ")";
+		out << ", " << (uint64_t)(r.nodes / std::max(r.seconds, 1e-9)) << " nps\n";
+	}
+	out << (all_ok ? "All passed" : "FAILED") << ", " << total_nodes << " nodes in " << total_secs << " s, "
+		<< (uint64_t)(total_nodes / std::max(total_secs, 1e-9)) << " nps\n";
+	return all_ok;
+}
@@ -0,0 +1,137 @@
+#include "qstore.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char QFILE_MAGIC[8] = {'C','R','L','Q','T','A','B','\0'};
+
+bool QFile::open(const std::string &path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(QFileHeader)) { ::close(fd); return false; }
+	void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd); // the mapping keeps the file alive
+	if (p == MAP_FAILED) return false;
+	const QFileHeader *h = (const QFileHeader*)p;
+	uint64_t cap = h->capacity;
+	bool ok = std::memcmp(h->magic, QFILE_MAGIC, 8) == 0 && h->version == QFILE_VERSION && h->record_size == sizeof(QRecord)
+		&& cap && (cap & (cap - 1)) == 0 && h->count < cap
+		&& (uint64_t)st.st_size == sizeof(QFileHeader) + cap * sizeof(QRecord);
+	if (!ok) { munmap(p, (size_t)st.st_size); return false; }
+	madvise(p, (size_t)st.st_size, MADV_RANDOM); // probes are scattered, skip readahead
+	map = p;
+	map_len = (size_t)st.st_size;
+	hdr = h;
+	recs = (const QRecord*)(h + 1);
+	return true;
+}
+
+void QFile::close() {
+	if (map) munmap(map, map_len);
+	map = nullptr; map_len = 0; hdr = nullptr; recs = nullptr;
+}
+
+const QRecord *QFile::probe(uint64_t hash) const {
+	if (!hdr || hash == 0) return nullptr;
+	uint64_t mask = hdr->capacity - 1;
+	// bounded, since a corrupt file may have no empty slot to end the run (open does not scan)
+	uint64_t i = hash & mask;
+	for (uint64_t n = 0; n < hdr->capacity && recs[i].hash; ++n, i = (i + 1) & mask) {
+		if (recs[i].hash == hash) return &recs[i];
+	}
+	return nullptr;
+}
+
+static void add_record(std::vector<QRecord> &slots, uint64_t &count, uint64_t hash, float value_sum, uint32_t visits) {
+	if (hash == 0) return; // reserved for empty slots
+	uint64_t mask = slots.size() - 1;
+	uint64_t i = hash & mask;
+	while (slots[i].hash && slots[i].hash != hash) i = (i + 1) & mask;
+	if (!slots[i].hash) { slots[i].hash = hash; ++count; }
+	slots[i].value_sum += value_sum;
+	slots[i].visits += visits;
+}
+
+static uint64_t table_capacity(uint64_t entries) {
+	uint64_t cap = 16;
+	while (cap < entries * 2) cap *= 2;
+	return cap;
+}
+
+bool write_qfile(const std::string &path, const QFile *base, const QTable &delta, uint64_t max_entries) {
+	uint64_t cap = table_capacity((base ? base->size() : 0) + delta.size());
+	std::vector<QRecord> slots(cap, QRecord{0, 0.0f, 0});
+	uint64_t count = 0;
+	if (base) {
+		const QRecord *r = base->records();
+		for (uint64_t i=0; i<base->capacity(); ++i) add_record(slots, count, r[i].hash, r[i].value_sum, r[i].visits);
+	}
+	for (auto &kv : delta) add_record(slots, count, kv.first, kv.second.first, kv.second.second);
+	if (max_entries && count > max_entries) {
+		// keep the most visited entries and rebuild a table sized for them
+		std::vector<QRecord> live;
+		live.reserve(count);
+		for (auto &r : slots) if (r.hash) live.push_back(r);
+		std::nth_element(live.begin(), live.begin() + max_entries, live.end(), [](const QRecord &a, const QRecord &b) { return a.visits > b.visits; });
+		live.resize(max_entries);
+		cap = table_capacity(max_entries);
+		slots.assign(cap, QRecord{0, 0.0f, 0});
+		count = 0;
+		for (auto &r : live) add_record(slots, count, r.hash, r.value_sum, r.visits);
+	}
+
+	QFileHeader h;
+	std::memcpy(h.magic, QFILE_MAGIC, 8);
+	h.version = QFILE_VERSION;
+	h.record_size = sizeof(QRecord);
+	h.capacity = cap;
+	h.count = count;
+	std::string tmp = path + ".tmp." + std::to_string(getpid());
+	FILE *f = std::fopen(tmp.c_str(), "wb");
+	if (!f) return false;
+	bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 && std::fwrite(slots.data(), sizeof(QRecord), cap, f) == cap;
+	ok = std::fflush(f) == 0 && ok;
+	ok = fsync(fileno(f)) == 0 && ok;
+	ok = std::fclose(f) == 0 && ok;
+	if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) { std::remove(tmp.c_str()); return false; }
+	return true;
+}
+
+void prune_qtable(QTable &q, size_t keep, const QFile *base) {
+	if (q.size() <= keep) return;
+	auto rank = [base](const QTable::value_type &kv) {
+		uint64_t v = kv.second.second;
+		if (base) if (const QRecord *r = base->probe(kv.first)) v += r->visits;
+		return v;
+	};
+	std::vector<uint64_t> visits;
+	visits.reserve(q.size());
+	for (auto &kv : q) visits.push_back(rank(kv));
+	size_t drop = q.size() - keep;
+	std::nth_element(visits.begin(), visits.begin() + drop, visits.end());
+	uint64_t cut = visits[drop]; // everything below goes, ties at cut only as far as needed
+	for (auto it = q.begin(); it != q.end() && drop; ) {
+		if (rank(*it) < cut) { it = q.erase(it); --drop; } else ++it;
+	}
+	for (auto it = q.begin(); it != q.end() && drop; ) {
+		if (rank(*it) == cut) { it = q.erase(it); --drop; } else ++it;
+	}
+}
+
+bool read_qtext(const std::string &path, QTable &q) {
+	std::ifstream in(path);
+	if (!in) return false;
+	uint64_t h; float s; uint32_t v;
+	while (in >> h >> s >> v) {
+		auto &e = q[h];
+		e.first += s;
+		e.second += v;
+	}
+	return true;
+}
@@ -0,0 +1,100 @@
+#include "selfplay.hpp"
+#include <chrono>
+#include <memory>
+#include <thread>
+
+SelfPlayStats run_selfplay(MCTS &store, const SelfPlayOptions &opt, std::ostream &progress) {
+	const int workers = std::max(1, std::min(opt.workers, opt.games));
+	const int report_every = std::max(1, opt.games / 20);
+	auto start = std::chrono::steady_clock::now();
+	std::atomic<int> white_wins{0}, black_wins{0}, draws{0}, finished{0}, time_losses{0};
+	std::atomic<int64_t> worst_overrun{0};
+	const bool timed = opt.clock_ms > 0;
+	std::mutex print_mu;
+	std::vector<QTable> acc(workers);
+	std::vector<std::vector<uint8_t>> record_buf(workers); // full ones go to opt.record
+
+	auto worker = [&](int w) {
+		std::unique_ptr<MCTS> mcts(new MCTS(opt.hash_mb));
+		mcts->enable_persistent_q(true);
+		mcts->set_playout_options(opt.playout);
+		mcts->set_evaluator(opt.evaluator);
+		mcts->set_batch_size(opt.batch);
+		mcts->set_egtb(opt.egtb);
+		mcts->attach_qbase(&store);
+		mcts->set_early_stop(timed);
+		std::vector<uint8_t> game; // this game's records until its result is known
+		std::vector<size_t> result_at;
+		std::vector<std::pair<Move,uint32_t>> visits;
+		// static game assignment keeps each accumulator's summation order independent of timing
+		for (int g = w; g < opt.games; g += workers) {
+			GLOBAL_RNG.seed(opt.seed ^ ((uint64_t)(g + 1) * 0x9E3779B97F4A7C15ull));
+			mcts->clear_tree();
+			Board b = Board::startpos();
+			game.clear();
+			result_at.clear();
+			int64_t clock[2] = {opt.clock_ms, opt.clock_ms};
+			bool flagged = false; // the side to move ran out of time
+			for (int ply=0; ply<opt.max_plies || flagged; ++ply) {
+				GameResult gr = flagged ? GameResult{b.white_to_move ? -1.0f : 1.0f, true} : b.evaluate_terminal();
+				if (gr.terminal) {
+					if (flagged) ++time_losses;
+					if (gr.reward>0) ++white_wins; else if (gr.reward<0) ++black_wins; else ++draws;
+					if (opt.record) {
+						for (size_t at : result_at) set_train_result(game, at, (int8_t)gr.reward);
+						std::vector<uint8_t> &buf = record_buf[w];
+						buf.insert(buf.end(), game.begin(), game.end());
+						if (buf.size() >= TrainWriter::CHUNK_BYTES) opt.record->submit(buf);
+					}
+					break;
+				}
+				mcts->reroot(b);
+				const int side = b.white_to_move ? 0 : 1;
+				TimePlan plan;
+				if (timed) {
+					TimeControl tc;
+					tc.time_left_ms = clock[side];
+					tc.increment_ms = opt.increment_ms;
+					plan = plan_move_time(tc, b);
+					mcts->set_time_plan(plan);
+				}
+				auto t0 = std::chrono::steady_clock::now();
+				Move mv = mcts->search_best_move(b, timed ? 0 : opt.simulations, 1.2f);
+				if (timed) {
+					int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+					int64_t over = ms - plan.hard_ms, worst = worst_overrun.load();
+					while (over > worst && !worst_overrun.compare_exchange_weak(worst, over)) {}
+					clock[side] -= ms;
+					if (clock[side] < 0) { flagged = true; continue; }
+					clock[side] += opt.increment_ms;
+				}
+				if (opt.record) {
+					mcts->root_visits(b, visits);
+					result_at.push_back(append_train_record(game, b, visits));
+				}
+				b.make_move(mv);
+			}
+			mcts->merge_q_into(acc[w]);
+			int done = ++finished;
+			if (done % report_every == 0 || done == opt.games) {
+				double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				std::lock_guard<std::mutex> lk(print_mu);
+				progress << "games " << done << "/" << opt.games << " W:" << white_wins << " B:" << black_wins << " D:" << draws
+					<< " (" << (uint64_t)(done * 3600.0 / std::max(secs, 1e-9)) << " games/h)\n";
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int w=1; w<workers; ++w) pool.emplace_back(worker, w);
+	worker(0);
+	for (auto &th : pool) th.join();
+	if (opt.record) for (auto &buf : record_buf) opt.record->submit(buf);
+	for (auto &q : acc) store.merge_q_from(q);
+
+	SelfPlayStats st;
+	st.white_wins = white_wins; st.black_wins = black_wins; st.draws = draws;
+	st.time_losses = time_losses;
+	st.worst_overrun_ms = worst_overrun;
+	st.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return st;
+}
@@ -0,0 +1,112 @@
+#include "stats.hpp"
+
+#ifdef CHESS_STATS
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+
+namespace {
+
+struct Registry {
+	std::mutex mu;
+	std::vector<SearchStats*> live;
+	SearchStats retired{}; // folded in by threads as they exit
+	std::chrono::steady_clock::time_point wall0 = std::chrono::steady_clock::now();
+	uint64_t tick0 = stat_ticks();
+};
+
+Registry &registry() {
+	static Registry r;
+	return r;
+}
+
+void add_into(SearchStats &dst, const SearchStats &src) {
+	for (int i=0; i<STAT_TIMERS; ++i) { dst.calls[i] += src.calls[i]; dst.ticks[i] += src.ticks[i]; }
+	for (int i=0; i<STAT_COUNTERS; ++i) dst.count[i] += src.count[i];
+	for (int i=0; i<STAT_DEPTHS; ++i) dst.depth[i] += src.depth[i];
+}
+
+struct Slot {
+	SearchStats s{};
+	Slot() {
+		Registry &r = registry();
+		std::lock_guard<std::mutex> g(r.mu);
+		r.live.push_back(&s);
+	}
+	~Slot() {
+		Registry &r = registry();
+		std::lock_guard<std::mutex> g(r.mu);
+		add_into(r.retired, s);
+		r.live.erase(std::find(r.live.begin(), r.live.end(), &s));
+	}
+};
+
+const char *TIMER_NAMES[STAT_TIMERS] = {"movegen", "make", "unmake", "terminal", "playout", "eval", "expand", "q seed", "q flush"};
+
+} // namespace
+
+SearchStats &thread_stats() {
+	thread_local Slot slot;
+	return slot.s;
+}
+
+void stats_reset() {
+	Registry &r = registry();
+	std::lock_guard<std::mutex> g(r.mu);
+	r.retired = SearchStats{};
+	for (SearchStats *s : r.live) *s = SearchStats{};
+	r.wall0 = std::chrono::steady_clock::now();
+	r.tick0 = stat_ticks();
+}
+
+void stats_dump(std::ostream &out) {
+	Registry &r = registry();
+	SearchStats t{};
+	double wall_ns;
+	uint64_t ticks;
+	{
+		std::lock_guard<std::mutex> g(r.mu);
+		t = r.retired;
+		for (const SearchStats *s : r.live) add_into(t, *s);
+		wall_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - r.wall0).count();
+		ticks = stat_ticks() - r.tick0;
+	}
+	// the tick source is a cycle or fixed-rate counter; calibrate it against the wall clock
+	double ns_per_tick = ticks ? wall_ns / (double)ticks : 1.0;
+	auto per = [](uint64_t a, uint64_t b) { return b ? (double)a / (double)b : 0.0; };
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize prec = out.precision();
+	out << std::fixed << std::setprecision(1);
+	uint64_t sims = t.count[ST_SIMULATIONS];
+	out << "stats: " << sims << " simulations in " << wall_ns / 1e6 << " ms (" << (double)sims * 1e9 / std::max(wall_ns, 1.0) << "/s, all threads)\n";
+	out << "  " << std::left << std::setw(10) << "timer" << std::right << std::setw(14) << "calls" << std::setw(12) << "ns/call" << std::setw(12) << "total ms" << '\n';
+	for (int i=0; i<STAT_TIMERS; ++i) {
+		if (!t.calls[i]) continue;
+		out << "  " << std::left << std::setw(10) << TIMER_NAMES[i] << std::right << std::setw(14) << t.calls[i]
+			<< std::setw(12) << per(t.ticks[i], t.calls[i]) * ns_per_tick << std::setw(12) << t.ticks[i] * ns_per_tick / 1e6 << '\n';
+	}
+	uint64_t probes = t.count[ST_TABLE_HIT] + t.count[ST_TABLE_MISS];
+	out << "  table: " << probes << " probes, " << per(t.count[ST_TABLE_HIT], probes) * 100 << "% hits, "
+		<< t.count[ST_TABLE_EVICT] << " live entries evicted\n";
+	out << "  bucket collisions: " << t.count[ST_TABLE_COLLISIONS] << " slots of other positions in the buckets those probes read\n";
+	out << "  playout length " << per(t.count[ST_PLAYOUT_PLIES], t.calls[TM_PLAYOUT]) << " plies, branching factor "
+		<< per(t.count[ST_EDGES], t.calls[TM_EXPAND]) << '\n';
+	if (t.count[ST_EGTB_HITS]) out << "  endgame tables resolved " << t.count[ST_EGTB_HITS] << " leaves and playouts\n";
+	uint64_t leaves = 0, depth_sum = 0;
+	int deepest = 0;
+	for (int d=0; d<STAT_DEPTHS; ++d) {
+		leaves += t.depth[d];
+		depth_sum += t.depth[d] * (uint64_t)d;
+		if (t.depth[d]) deepest = d;
+	}
+	out << "  leaf depth " << per(depth_sum, leaves) << " on average, " << deepest << (deepest == STAT_DEPTHS - 1 ? "+" : "") << " at most\n";
+	for (int d=0; d<=deepest && leaves; ++d) {
+		double pct = per(t.depth[d], leaves) * 100;
+		out << "  " << std::setw(6) << d << std::setw(7) << pct << "% " << std::string((size_t)(pct / 2 + 0.5), '#') << '\n';
+	}
+	out.flags(flags);
+	out.precision(prec);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#include "timeman.hpp"
+#include "bitboard.hpp"
+#include <algorithm>
+
+static constexpr int MOVES_LEFT_ENDGAME = 20;
+static constexpr int MOVES_LEFT_OPENING = 40;
+static constexpr int START_PIECE_MATERIAL = 2 * (2*3 + 2*3 + 2*5 + 9); // knights, bishops, rooks, queen
+
+TimePlan plan_move_time(const TimeControl &tc, const Board &b) {
+	TimePlan p;
+	if (tc.time_left_ms < 0) return p;
+	// game phase from the non-pawn material left: 1 at the start, 0 with only kings and pawns
+	int pieces = 0;
+	for (int s : {1, -1}) {
+		pieces += 3 * popcount(b.bb((Piece)(s * WN)) | b.bb((Piece)(s * WB)));
+		pieces += 5 * popcount(b.bb((Piece)(s * WR))) + 9 * popcount(b.bb((Piece)(s * WQ)));
+	}
+	double phase = std::min(1.0, pieces / (double)START_PIECE_MATERIAL);
+	int moves_left = tc.moves_to_go > 0 ? tc.moves_to_go
+		: MOVES_LEFT_ENDGAME + (int)std::lround((MOVES_LEFT_OPENING - MOVES_LEFT_ENDGAME) * phase);
+	const int64_t usable = std::max<int64_t>(1, tc.time_left_ms - tc.overhead_ms);
+	p.soft_ms = std::min(usable, usable / moves_left + tc.increment_ms * 3 / 4);
+	p.hard_ms = std::min(usable, std::max(p.soft_ms, std::min(p.soft_ms * HARD_STRETCH, usable / HARD_SHARE)));
+	p.soft_ms = std::max<int64_t>(1, p.soft_ms);
+	p.hard_ms = std::max<int64_t>(1, p.hard_ms);
+	return p;
+}
@@ -0,0 +1,165 @@
+#include "trainfile.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char TRAIN_MAGIC[8] = {'C','R','L','T','R','A','I','N'};
+
+uint16_t pack_move(const Move &m) {
+	int promo = (m.flags & 4) ? abs_piece((Piece)m.promotion) : 0;
+	return (uint16_t)(m.from | m.to << 6 | promo << 12);
+}
+
+size_t append_train_record(std::vector<uint8_t> &buf, const Board &b, const std::vector<std::pair<Move,uint32_t>> &visits) {
+	TrainRecordHead h;
+	std::memset(&h, 0, sizeof(h));
+	for (int sq=0; sq<64; ++sq) h.board[sq >> 1] |= (uint8_t)((b.squares[sq] + 6) << ((sq & 1) * 4));
+	h.flags = (uint8_t)((b.white_to_move ? 1 : 0) | (b.castling_rights & 15) << 1);
+	h.ep_square = b.ep_square;
+	h.num_moves = 0;
+	h.halfmove_clock = b.halfmove_clock;
+	uint32_t top = 0;
+	for (auto &mv : visits) top = std::max(top, mv.second);
+	const uint32_t div = top / 65536 + 1; // keeps the largest count within 16 bits
+	size_t at = buf.size();
+	buf.resize(at + sizeof(h));
+	for (auto &mv : visits) {
+		if (!mv.second) continue;
+		TrainMove tm{pack_move(mv.first), (uint16_t)std::max<uint32_t>(1, mv.second / div)};
+		const uint8_t *p = (const uint8_t*)&tm;
+		buf.insert(buf.end(), p, p + sizeof(tm));
+		++h.num_moves;
+	}
+	std::memcpy(buf.data() + at, &h, sizeof(h));
+	return at + offsetof(TrainRecordHead, result);
+}
+
+bool TrainWriter::open(const std::string &path, size_t queue_limit) {
+	close();
+	FILE *f = std::fopen(path.c_str(), "ab+");
+	if (!f) return false;
+	std::fseek(f, 0, SEEK_END);
+	long size = std::ftell(f);
+	bool ok;
+	if (size == 0) {
+		TrainFileHeader h;
+		std::memcpy(h.magic, TRAIN_MAGIC, 8);
+		h.version = TRAINFILE_VERSION;
+		h.reserved = 0;
+		ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+	} else {
+		TrainFileHeader h;
+		std::rewind(f);
+		ok = std::fread(&h, sizeof(h), 1, f) == 1 && std::memcmp(h.magic, TRAIN_MAGIC, 8) == 0 && h.version == TRAINFILE_VERSION;
+	}
+	if (!ok) { std::fclose(f); return false; }
+	file = f;
+	limit = std::max<size_t>(1, queue_limit);
+	closing = failed = false;
+	written = 0;
+	writer = std::thread(&TrainWriter::run, this);
+	return true;
+}
+
+void TrainWriter::submit(std::vector<uint8_t> &buf) {
+	if (buf.empty()) return;
+	std::unique_lock<std::mutex> lk(mu);
+	cv.wait(lk, [&]() { return queue.size() < limit; });
+	queue.emplace_back();
+	queue.back().swap(buf);
+	cv.notify_all();
+}
+
+void TrainWriter::run() {
+	while (true) {
+		std::vector<uint8_t> chunk;
+		{
+			std::unique_lock<std::mutex> lk(mu);
+			cv.wait(lk, [&]() { return !queue.empty() || closing; });
+			if (queue.empty()) return;
+			chunk.swap(queue.front());
+			queue.pop_front();
+			cv.notify_all(); // room for a blocked producer
+		}
+		// append mode puts every chunk at the end, whole, in submission order
+		if (std::fwrite(chunk.data(), 1, chunk.size(), file) != chunk.size()) failed = true;
+		else written += chunk.size();
+	}
+}
+
+bool TrainWriter::close() {
+	if (!file) return true;
+	{
+		std::lock_guard<std::mutex> lk(mu);
+		closing = true;
+		cv.notify_all();
+	}
+	writer.join();
+	bool ok = !failed && std::fflush(file) == 0;
+	ok = std::fclose(file) == 0 && ok;
+	file = nullptr;
+	return ok;
+}
+
+bool TrainReader::open(const std::string &path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TrainFileHeader)) { ::close(fd); return false; }
+	void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED) return false;
+	const TrainFileHeader *h = (const TrainFileHeader*)p;
+	if (std::memcmp(h->magic, TRAIN_MAGIC, 8) != 0 || h->version != TRAINFILE_VERSION) { munmap(p, (size_t)st.st_size); return false; }
+	madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+	map = p;
+	map_len = (size_t)st.st_size;
+	pos = sizeof(TrainFileHeader);
+	return true;
+}
+
+void TrainReader::close() {
+	if (map) munmap(map, map_len);
+	map = nullptr; map_len = 0; pos = 0;
+}
+
+bool TrainReader::next(TrainSample &out) {
+	if (!map || map_len - pos < sizeof(TrainRecordHead)) return false;
+	const uint8_t *base = (const uint8_t*)map + pos;
+	TrainRecordHead h;
+	std::memcpy(&h, base, sizeof(h));
+	size_t len = sizeof(h) + h.num_moves * sizeof(TrainMove);
+	if (map_len - pos < len) return false;
+	Board b;
+	for (int sq=0; sq<64; ++sq) {
+		int code = (h.board[sq >> 1] >> ((sq & 1) * 4)) & 15;
+		if (code > 12) return false;
+		if (code != 6) b.put_piece(sq, (Piece)(code - 6));
+	}
+	if (b.king_sq[0] < 0 || b.king_sq[1] < 0) return false;
+	b.white_to_move = h.flags & 1;
+	b.castling_rights = (h.flags >> 1) & 15;
+	b.ep_square = h.ep_square;
+	b.halfmove_clock = h.halfmove_clock;
+	b.update_hash();
+	MoveList legal;
+	b.generate_legal_moves(legal);
+	out.visits.clear();
+	for (int i=0; i<h.num_moves; ++i) {
+		TrainMove tm;
+		std::memcpy(&tm, base + sizeof(h) + i * sizeof(TrainMove), sizeof(tm));
+		const Move *m = std::find_if(legal.begin(), legal.end(), [&](const Move &l) { return pack_move(l) == tm.move; });
+		if (m == legal.end()) return false;
+		out.visits.emplace_back(*m, tm.visits);
+	}
+	out.board = b;
+	out.result = h.result;
+	pos += len;
+	return true;
+}
@@ -0,0 +1,84 @@
+#include "ucb.hpp"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Lanes keep their own running best (strict >, so the first maximum per lane wins); the lane
+// winners are then reduced by score and lowest index, which matches a left-to-right scalar scan.
+static inline void merge_lanes(const float *score, const uint32_t *index, int lanes, float &best, size_t &best_i) {
+	for (int k=0; k<lanes; ++k) {
+		if (score[k] > best || (score[k] == best && index[k] < best_i)) { best = score[k]; best_i = index[k]; }
+	}
+}
+
+size_t select_ucb(const uint32_t *visits, const float *values, size_t n, float c_sqrt_parent) {
+	float best = -std::numeric_limits<float>::max();
+	size_t best_i = 0, i = 0;
+#if defined(__AVX2__)
+	const __m256 one = _mm256_set1_ps(1.0f), cs = _mm256_set1_ps(c_sqrt_parent), big = _mm256_set1_ps(UCB_UNVISITED);
+	const __m256i zero = _mm256_setzero_si256(), step = _mm256_set1_epi32(8), count = _mm256_set1_epi32((int)n);
+	__m256 bestv = _mm256_set1_ps(best);
+	__m256i besti = zero, idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	for (; i < n; i += 8) {
+		// the tail is masked rather than finished in scalar code, so every edge is scored by
+		// the same instructions and exact ties resolve the same way everywhere
+		__m256i live = _mm256_cmpgt_epi32(count, idx);
+		__m256i vi = _mm256_maskload_epi32((const int*)(visits + i), live);
+		__m256 w = _mm256_maskload_ps(values + i, live);
+		__m256 v = _mm256_cvtepi32_ps(vi); // visit counts stay far below 2^31
+		__m256 s = _mm256_add_ps(_mm256_div_ps(w, _mm256_max_ps(v, one)), _mm256_div_ps(cs, _mm256_add_ps(one, v)));
+		s = _mm256_blendv_ps(s, big, _mm256_castsi256_ps(_mm256_cmpeq_epi32(vi, zero)));
+		__m256 gt = _mm256_and_ps(_mm256_cmp_ps(s, bestv, _CMP_GT_OQ), _mm256_castsi256_ps(live));
+		bestv = _mm256_blendv_ps(bestv, s, gt);
+		besti = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(besti), _mm256_castsi256_ps(idx), gt));
+		idx = _mm256_add_epi32(idx, step);
+	}
+	alignas(32) float sc[8];
+	alignas(32) uint32_t ix[8];
+	_mm256_store_ps(sc, bestv);
+	_mm256_store_si256((__m256i*)ix, besti);
+	merge_lanes(sc, ix, 8, best, best_i);
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	const float32x4_t one = vdupq_n_f32(1.0f), cs = vdupq_n_f32(c_sqrt_parent), big = vdupq_n_f32(UCB_UNVISITED);
+	const uint32x4_t zero = vdupq_n_u32(0), step = vdupq_n_u32(4), count = vdupq_n_u32((uint32_t)n);
+	const uint32_t lane_idx[4] = {0, 1, 2, 3};
+	float32x4_t bestv = vdupq_n_f32(best);
+	uint32x4_t besti = zero, idx = vld1q_u32(lane_idx);
+	for (; i < n; i += 4) {
+		uint32x4_t vi;
+		float32x4_t w;
+		if (i + 4 <= n) {
+			vi = vld1q_u32(visits + i);
+			w = vld1q_f32(values + i);
+		} else { // no masked loads on NEON: pad the tail through a small buffer
+			uint32_t tv[4] = {0, 0, 0, 0};
+			float tw[4] = {0, 0, 0, 0};
+			for (size_t k=0; i+k<n; ++k) { tv[k] = visits[i+k]; tw[k] = values[i+k]; }
+			vi = vld1q_u32(tv);
+			w = vld1q_f32(tw);
+		}
+		uint32x4_t live = vcltq_u32(idx, count);
+		float32x4_t v = vcvtq_f32_u32(vi);
+		float32x4_t s = vaddq_f32(vdivq_f32(w, vmaxq_f32(v, one)), vdivq_f32(cs, vaddq_f32(one, v)));
+		s = vbslq_f32(vceqq_u32(vi, zero), big, s);
+		uint32x4_t gt = vandq_u32(vcgtq_f32(s, bestv), live);
+		bestv = vbslq_f32(gt, s, bestv);
+		besti = vbslq_u32(gt, idx, besti);
+		idx = vaddq_u32(idx, step);
+	}
+	float sc[4];
+	uint32_t ix[4];
+	vst1q_f32(sc, bestv);
+	vst1q_u32(ix, besti);
+	merge_lanes(sc, ix, 4, best, best_i);
+#else
+	for (; i < n; ++i) {
+		float v = (float)visits[i];
+		float s = visits[i] ? values[i] / std::max(v, 1.0f) + c_sqrt_parent / (1.0f + v) : UCB_UNVISITED;
+		if (s > best) { best = s; best_i = i; }
+	}
+#endif
+	return best_i;
+}
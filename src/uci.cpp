@@ -0,0 +1,193 @@
+#include "uci.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+std::string lower(std::string s) {
+	std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return s;
+}
+
+// Picks the legal move whose UCI spelling is tok ("e2e4", "e7e8q"); false if there is none.
+bool parse_move(const Board &b, const std::string &tok, Move &out) {
+	MoveList legal;
+	b.generate_legal_moves(legal);
+	for (const Move &m : legal) {
+		if (move_to_uci(m) == tok) { out = m; return true; }
+	}
+	return false;
+}
+
+// Maps a mean result in [-1, 1] to centipawns for GUIs; steep near the ends like a logistic inverse.
+int q_to_cp(float q) {
+	q = std::max(-0.99f, std::min(0.99f, q));
+	return (int)std::lround(100.0 * std::tan(1.5 * q));
+}
+
+class UciEngine {
+public:
+	UciEngine(MCTS &m, UciSettings &s, std::ostream &o) : mcts(m), settings(s), out(o), board(Board::startpos()), stop(false) {
+		mcts.set_stop_flag(&stop);
+		mcts.set_info_callback([this](const SearchInfo &info) { send_info(info); }, 1000);
+	}
+	~UciEngine() {
+		halt();
+		mcts.set_stop_flag(nullptr);
+		mcts.set_info_callback(nullptr, 1000);
+	}
+
+	bool command(const std::string &line); // false on quit
+
+private:
+	MCTS &mcts;
+	UciSettings &settings;
+	std::ostream &out;
+	std::mutex out_mu; // the search thread prints info/bestmove while we answer commands
+	Board board;
+	std::thread searcher;
+	std::atomic<bool> stop;
+
+	void send(const std::string &s) {
+		std::lock_guard<std::mutex> g(out_mu);
+		out << s << std::endl;
+	}
+	void send_info(const SearchInfo &info) {
+		std::ostringstream ss;
+		ss << "info depth " << std::max<size_t>(1, info.pv.size()) << " score cp " << q_to_cp(info.q)
+			<< " nodes " << info.simulations << " nps " << info.simulations * 1000 / (uint64_t)std::max<int64_t>(1, info.elapsed_ms)
+			<< " time " << info.elapsed_ms << " hashfull " << mcts.hashfull();
+		if (!info.pv.empty()) {
+			ss << " pv";
+			for (const Move &m : info.pv) ss << ' ' << move_to_uci(m);
+		}
+		send(ss.str());
+	}
+	void halt() {
+		stop = true;
+		if (searcher.joinable()) searcher.join();
+		stop = false;
+	}
+	void position(std::istringstream &in);
+	void go(std::istringstream &in);
+	void setoption(std::istringstream &in);
+};
+
+bool UciEngine::command(const std::string &line) {
+	std::istringstream in(line);
+	std::string cmd;
+	if (!(in >> cmd)) return true;
+	if (cmd == "uci") {
+		send("id name chess_rl");
+		send("id author chess_rl developers");
+		send("option name Threads type spin default " + std::to_string(settings.threads) + " min 1 max 512");
+		send("option name Hash type spin default " + std::to_string(settings.hash_mb) + " min 1 max 65536");
+		send("option name QFile type string default " + (settings.qfile.empty() ? std::string("<empty>") : settings.qfile));
+		send(std::string("option name OwnBook type check default ") + (settings.own_book ? "true" : "false"));
+		send("uciok");
+	}
+	else if (cmd == "isready") send("readyok");
+	else if (cmd == "ucinewgame") { halt(); mcts.clear_tree(); board = Board::startpos(); }
+	else if (cmd == "position") { halt(); position(in); }
+	else if (cmd == "go") { halt(); go(in); }
+	else if (cmd == "stop") halt();
+	else if (cmd == "setoption") { halt(); setoption(in); }
+	else if (cmd == "quit") { halt(); return false; }
+	return true;
+}
+
+void UciEngine::position(std::istringstream &in) {
+	std::string tok, fen;
+	in >> tok;
+	Board b = Board::startpos();
+	if (tok == "fen") {
+		while (in >> tok && tok != "moves") fen += (fen.empty() ? "" : " ") + tok;
+		if (!b.set_fen(fen)) { send("info string bad fen " + fen); return; }
+	} else if (tok == "startpos") {
+		in >> tok;
+	}
+	if (tok == "moves") {
+		while (in >> tok) {
+			Move m;
+			if (!parse_move(b, tok, m)) { send("info string illegal move " + tok); break; }
+			b.make_move(m);
+		}
+	}
+	board = b;
+}
+
+void UciEngine::go(std::istringstream &in) {
+	int64_t wtime = -1, btime = -1, winc = 0, binc = 0, movetime = 0, movestogo = 0, nodes = 0;
+	bool infinite = false;
+	std::string tok;
+	while (in >> tok) {
+		if (tok == "infinite") infinite = true;
+		else if (tok == "wtime") in >> wtime;
+		else if (tok == "btime") in >> btime;
+		else if (tok == "winc") in >> winc;
+		else if (tok == "binc") in >> binc;
+		else if (tok == "movetime") in >> movetime;
+		else if (tok == "movestogo") in >> movestogo;
+		else if (tok == "nodes") in >> nodes;
+	}
+	TimePlan plan;
+	TimeControl tc;
+	tc.time_left_ms = board.white_to_move ? wtime : btime;
+	tc.increment_ms = board.white_to_move ? winc : binc;
+	tc.moves_to_go = (int)std::max<int64_t>(0, movestogo);
+	if (movetime > 0) plan.soft_ms = plan.hard_ms = movetime;
+	else if (tc.time_left_ms >= 0) plan = plan_move_time(tc, board);
+	Move book_move;
+	if (!infinite && settings.own_book && settings.book && settings.book->pick(board, settings.book_opt, book_move)) {
+		send("info string book move");
+		send("bestmove " + move_to_uci(book_move));
+		return;
+	}
+	int sims = nodes > 0 ? (int)std::min<int64_t>(nodes, INT_MAX) : 0;
+	if (!infinite && !sims && !plan.hard_ms) sims = 1500; // bare "go": same effort as the REPL's play
+	mcts.set_time_plan(infinite ? TimePlan() : plan);
+	mcts.reroot(board);
+	searcher = std::thread([this, sims]() {
+		Board root = board;
+		STATS_RESET();
+		Move best = mcts.search_best_move(root, sims, 1.2f, settings.threads);
+		// under "go infinite" the GUI expects bestmove only after its stop
+		send("bestmove " + (best.from == best.to ? std::string("0000") : move_to_uci(best)));
+		STATS_DUMP(std::cerr); // stdout belongs to the protocol
+	});
+}
+
+void UciEngine::setoption(std::istringstream &in) {
+	std::string tok, name, value;
+	in >> tok; // "name"
+	while (in >> tok && tok != "value") name += (name.empty() ? "" : " ") + tok;
+	std::getline(in >> std::ws, value);
+	name = lower(name);
+	if (name == "threads") settings.threads = std::max(1, std::atoi(value.c_str()));
+	else if (name == "hash") {
+		settings.hash_mb = (size_t)std::max(1, std::atoi(value.c_str()));
+		mcts.set_hash_mb(settings.hash_mb);
+	}
+	else if (name == "ownbook") settings.own_book = lower(value) == "true";
+	else if (name == "qfile") {
+		if (value.empty() || value == "<empty>") return;
+		settings.qfile = value;
+		if (!mcts.load_qtable(value)) send("info string no Q-table at " + value + ", starting empty");
+	}
+	else send("info string unknown option " + name);
+}
+
+} // namespace
+
+void uci_loop(MCTS &mcts, UciSettings &settings, std::istream &in, std::ostream &out) {
+	UciEngine engine(mcts, settings, out);
+	std::string line;
+	if (!engine.command("uci")) return; // the caller consumed the initial "uci"
+	while (std::getline(in, line)) {
+		if (!engine.command(line)) break;
+	}
+}
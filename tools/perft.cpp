@@ -0,0 +1,36 @@
+// Standalone perft driver: move generator regression check and speed benchmark.
+//   perft [--threads N] [--hash MB] [--divide] <depth> [fen]
+//   perft --suite [--threads N] [--hash MB] [--max-depth N]
+#include "perft.hpp"
+#include <cctype>
+#include <thread>
+
+static void usage() {
+	std::cerr << "usage: perft [--threads N] [--hash MB] [--divide] <depth> [fen]\n"
+		"       perft --suite [--threads N] [--hash MB] [--max-depth N]\n";
+}
+
+int main(int argc, char** argv) {
+	PerftOptions opt;
+	bool suite = false;
+	int depth = -1, depth_cap = 0;
+	std::string fen;
+	for (int i=1; i<argc; ++i) {
+		std::string a = argv[i];
+		bool has_val = i + 1 < argc;
+		if (a == "--suite") suite = true;
+		else if (a == "--divide") opt.divide = true;
+		else if (a == "--threads" && has_val) { opt.threads = std::atoi(argv[++i]); if (opt.threads <= 0) opt.threads = (int)std::thread::hardware_concurrency(); }
+		else if (a == "--hash" && has_val) opt.hash_mb = (size_t)std::atoll(argv[++i]);
+		else if (a == "--max-depth" && has_val) depth_cap = std::atoi(argv[++i]);
+		else if (depth < 0 && !a.empty() && std::isdigit((unsigned char)a[0])) depth = std::atoi(a.c_str());
+		else if (depth >= 0) { if (!fen.empty()) fen += ' '; fen += a; } // FEN may arrive as several argv words
+		else { usage(); return 2; }
+	}
+	if (suite) return run_perft_suite(opt, std::cout, depth_cap) ? 0 : 1;
+	if (depth < 0) { usage(); return 2; }
+	Board b = Board::startpos();
+	if (!fen.empty() && !b.set_fen(fen)) { std::cerr << "bad FEN: " << fen << '\n'; return 2; }
+	run_perft(b, depth, opt, std::cout);
+	return 0;
+}
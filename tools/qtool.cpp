@@ -0,0 +1,59 @@
+// Offline Q-table maintenance.
+//   qtool convert <in.txt> <out.bin>   legacy text format -> binary
+//   qtool merge [--capacity N] <out.bin> <in>...   sums tables (binary or text); one input compacts
+//   qtool info <file.bin>
+#include "qstore.hpp"
+
+static void usage() {
+	std::cerr << "usage: qtool convert <in.txt> <out.bin>\n"
+		"       qtool merge [--capacity N] <out.bin> <in>...\n"
+		"       qtool info <file.bin>\n";
+}
+
+static bool add_qfile(const std::string &path, QTable &q) {
+	QFile f;
+	if (!f.open(path)) return read_qtext(path, q);
+	for (uint64_t i=0; i<f.capacity(); ++i) {
+		const QRecord &r = f.records()[i];
+		if (!r.hash) continue;
+		auto &e = q[r.hash];
+		e.first += r.value_sum;
+		e.second += r.visits;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	std::string cmd = argc > 1 ? argv[1] : "";
+	if (cmd == "convert" && argc == 4) {
+		QTable q;
+		if (!read_qtext(argv[2], q)) { std::cerr << "cannot read " << argv[2] << '\n'; return 1; }
+		if (!write_qfile(argv[3], nullptr, q)) { std::cerr << "cannot write " << argv[3] << '\n'; return 1; }
+		std::cout << q.size() << " entries written to " << argv[3] << '\n';
+		return 0;
+	}
+	if (cmd == "merge") {
+		uint64_t capacity = 0;
+		int i = 2;
+		if (i + 1 < argc && std::string(argv[i]) == "--capacity") { capacity = std::strtoull(argv[i+1], nullptr, 10); i += 2; }
+		if (argc - i < 2) { usage(); return 2; }
+		std::string out = argv[i++];
+		QTable q;
+		for (; i<argc; ++i) {
+			if (!add_qfile(argv[i], q)) { std::cerr << "cannot read " << argv[i] << '\n'; return 1; }
+		}
+		if (!write_qfile(out, nullptr, q, capacity)) { std::cerr << "cannot write " << out << '\n'; return 1; }
+		std::cout << std::min<uint64_t>(q.size(), capacity ? capacity : q.size()) << " entries written to " << out << '\n';
+		return 0;
+	}
+	if (cmd == "info" && argc == 3) {
+		QFile f;
+		if (!f.open(argv[2])) { std::cerr << argv[2] << ": not a v" << QFILE_VERSION << " Q file\n"; return 1; }
+		uint64_t visits = 0;
+		for (uint64_t i=0; i<f.capacity(); ++i) visits += f.records()[i].visits;
+		std::cout << "entries " << f.size() << " capacity " << f.capacity() << " visits " << visits << '\n';
+		return 0;
+	}
+	usage();
+	return 2;
+}
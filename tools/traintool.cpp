@@ -0,0 +1,41 @@
+// Inspects self-play training files written by `chess_rl --record`.
+//   traintool info <file>          record count, results, mean visited moves
+//   traintool dump <file> [n]      first n records (default 10): fen, result, visits per move
+#include "trainfile.hpp"
+#include <algorithm>
+
+static void usage() {
+	std::cerr << "usage: traintool info <file>\n"
+		"       traintool dump <file> [n]\n";
+}
+
+int main(int argc, char** argv) {
+	std::string cmd = argc > 1 ? argv[1] : "";
+	if ((cmd != "info" && cmd != "dump") || argc < 3) { usage(); return 2; }
+	TrainReader r;
+	if (!r.open(argv[2])) { std::cerr << argv[2] << ": not a v" << TRAINFILE_VERSION << " training file\n"; return 1; }
+	TrainSample s;
+	if (cmd == "info") {
+		uint64_t n = 0, moves = 0, wins = 0, losses = 0;
+		while (r.next(s)) {
+			++n;
+			moves += s.visits.size();
+			wins += s.result > 0;
+			losses += s.result < 0;
+		}
+		std::cout << "records " << n << " white wins " << wins << " black wins " << losses << " draws " << n - wins - losses
+			<< " visited moves/record " << (n ? (double)moves / n : 0.0) << '\n';
+		if (r.corrupt()) { std::cerr << argv[2] << ": corrupt record " << n << " at byte " << r.offset() << ", the rest is unread\n"; return 1; }
+		return 0;
+	}
+	long limit = argc > 3 ? std::atol(argv[3]) : 10;
+	long i = 0;
+	for (; i<limit && r.next(s); ++i) {
+		std::sort(s.visits.begin(), s.visits.end(), [](const std::pair<Move,uint32_t> &a, const std::pair<Move,uint32_t> &b) { return a.second > b.second; });
+		std::cout << s.board.fen() << " result " << (int)s.result;
+		for (auto &mv : s.visits) std::cout << ' ' << move_to_uci(mv.first) << ':' << mv.second;
+		std::cout << '\n';
+	}
+	if (i < limit && r.corrupt()) { std::cerr << argv[2] << ": corrupt record " << i << " at byte " << r.offset() << '\n'; return 1; }
+	return 0;
+}